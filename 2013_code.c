@@ -16,6 +16,7 @@
  *------------------------------------------------------------------------------*/
 #include  <stdint.h>
 #include  <msp430x20x3.h>
+#include  <pad_i2c.h>
 
 #define FALSE 0
 #define TRUE (!FALSE)
@@ -24,51 +25,205 @@ unsigned int timer_count;
 
 void usi_i2c_init(void);
 void send_to_host(int position);
+void read_config(void);
 
 uint8_t test_seq_data = 0;
-uint8_t host_data = 0;
+
+/* ------------------------------- STACK USAGE ------------------------------- */
+
+/* The F2013 only has 128 bytes of RAM, shared by the globals and the stack.
+   The unused stack is painted at reset, and stack_peak tracks the deepest
+   point reached since then (watch it from the debugger). */
+#define STACK_PAINT 0xA5
+
+#if defined(__IAR_SYSTEMS_ICC__)
+#pragma segment="CSTACK"
+#define STACK_START ((uint8_t *) __segment_begin("CSTACK"))
+#define STACK_END   ((uint8_t *) __segment_end("CSTACK"))
+#else
+extern uint8_t _stack;                      /* TI linker: .stack section bounds */
+extern uint8_t __STACK_END;
+#define STACK_START (&_stack)
+#define STACK_END   (&__STACK_END)
+#endif
+
+uint8_t stack_peak = 0;
+
+void stack_paint(void)
+{
+    uint8_t *p = STACK_START;
+    uint8_t *sp = (uint8_t *) __get_SP_register();
+
+    while (p < sp - 2)                      /* Leave this function's frame alone */
+        *p++ = STACK_PAINT;
+}
+
+uint8_t stack_high_water(void)
+{
+    uint8_t *p = STACK_START;
+
+    while (p < STACK_END  &&  *p == STACK_PAINT)
+        p++;
+    return STACK_END - p;                   /* Bytes used at the deepest point */
+}
+
+/* The pad (P1.1) is also TA0's CCI0A input, so the discharge/charge edge is
+   time-stamped by the Timer_A capture hardware instead of by reading TAR in
+   an interrupt: interrupt entry latency no longer adds jitter to the reading.
+   That allows the timer to run at the full SMCLK for 8x the resolution of
+   the old SMCLK/8 count, and a shorter filter. (The F2013 has no comparator,
+   so the pin's digital input threshold stays the reference.) */
+#define MEASURE_SHIFT       3           /* Counts per old SMCLK/8 count, as a shift */
+#define FILTER_SHIFT        2           /* IIR: filtered += margin - filtered/2^n (was 4) */
+#define CAPTURE_TIMEOUT     0x4000      /* ~1ms; two of them still fit the 16 bit sum */
+
+uint8_t filter_shift = FILTER_SHIFT;
+
+unsigned int capture_edge(unsigned int edge)
+{
+    /* Arm the capture while the pad is still driven: with OUT preset to the
+       level P1OUT drives, handing the pin to Timer_A does not change the pad.
+       The snapshot and the release then happen back to back, so the edge
+       cannot come before the capture is ready for it. */
+    TACCTL0 = edge | CCIS_0 | SCS | CAP | CCIE | OUTMOD_0 | ((P1OUT & BIT1)  ?  OUT  :  0);
+    P1SEL |= BIT1;
+    _DINT();
+    timer_count = TAR;                          /* Take a snapshot of the timer... */
+    P1DIR &= ~BIT1;                             /* ...and let the pad float */
+    TACCR1 = timer_count + CAPTURE_TIMEOUT;     /* Give up if the edge never comes */
+    TACCTL1 = CCIE;
+    /* Wait for the capture interrupt, or the timeout. Check then sleep with
+       interrupts off, so neither can slip in between. */
+    while ((TACCTL0 & CCIE)  &&  (TACCTL1 & CCIE))
+    {
+        __bis_SR_register(LPM0_bits + GIE);
+        _DINT();
+    }
+    if (TACCTL0 & CCIE)
+    {
+        TACCTL0 &= ~CCIE;                       /* No edge: report the longest time */
+        timer_count = CAPTURE_TIMEOUT;
+    }
+    TACCTL1 &= ~CCIE;
+    _EINT();
+    P1SEL &= ~BIT1;
+    return timer_count;
+}
 
 unsigned int measure_key_capacitance(void)
 {
-    int sum;
+    unsigned int sum;
 
     /* Right now, all keys should be driven low, forming a "ground" area */
     P1OUT |= BIT1;              /* Take the active key high to charge the pad */
     _NOP(); _NOP(); _NOP();     /* Allow a short delay for the hard pull high to really charge the pad */
-    P1IES |= BIT1;              /* Configure a port interrupt as the pin discharges */
-    P1IE |= BIT1;
-    P1DIR &= ~BIT1;
-    timer_count = TAR;          /* Take a snapshot of the timer... */
-    LPM0;                       /* ...and wait for the discharge to cause an interrupt.  */
-    P1IE &= ~BIT1;              /* Disable active key interrupts */
+    sum = capture_edge(CM_2);   /* Time the discharge (falling edge) */
     P1OUT &= ~BIT1;             /* Discharge the key */
     P1DIR |= BIT1;              /* switch active key to output low to save power */
-    sum = timer_count;
     P1OUT |= BIT0;              /* We want the resistor to charge the pad this time */
     _NOP(); _NOP(); _NOP();     /* Allow a short delay for the hard pull down to really discharge the pad */
-    P1IES &= ~BIT1;             /* Configure a port interrupt as the pin charges */
-    P1IE |= BIT1;
-    P1DIR &= ~BIT1;
-    timer_count = TAR;          /* Take a snapshot of the timer... */
-    LPM0;                       /* ...and wait for the discharge to cause an interrupt. */
-    P1IE &= ~BIT1;              /* Disable active key interrupt */
+    sum += capture_edge(CM_1);  /* Time the charge (rising edge) */
     P1OUT &= ~(BIT1 | BIT0);    /* Return the keys to the "ground" state */
     P1DIR |= BIT1;
-    sum += timer_count;
-    return sum;                 /* The sum od the two readings is our answer */
+    return sum;                 /* The sum of the two readings is our answer */
 }
 
-int base_capacitance = 0;
+unsigned int base_capacitance = 0;
 long int filtered = 0;
-int measured;
+unsigned int measured;
 int margin;
 int to_host;
 
+/* ------------------------------- RUN TIME TUNING ------------------------------- */
+
+/* The FG4618 tunes the scan through the registers in pad_i2c.h, read back
+   every PAD_POLL_SCANS scans, and sees the results in the status items sent
+   along with the pad level. */
+#define NOISE_SHIFT         4           /* Noise floor average over 16 scans */
+#define NOISE_MAX           0x0FFF      /* Keeps the noise sum in 16 bits */
+#define OVERFLOWS_PER_SEC   244         /* 16MHz / 65536 Timer_A overflows */
+
+unsigned int scan_delay = 1000;         /* Pacing loop between scans */
+uint8_t pad_clamp = 255;                /* Pad levels from here are sent as 255 */
+uint8_t pad_floor = 0;                  /* Pad levels up to here are sent as 0 */
+unsigned int noise_sum = 0;             /* NOISE_SHIFT scaled average |deviation| */
+unsigned int scans = 0;
+unsigned int scan_rate = 0;             /* Scans in the last second */
+uint8_t overflows = 0;
+unsigned int nack_count = 0;
+uint8_t status_item = PAD_STAT_BASELINE;
+uint8_t poll_count = 0;
+
+void apply_config(uint8_t reg, uint8_t value)
+{
+    switch (reg)
+    {
+    case PAD_REG_FILTER:
+        if (value >= 1  &&  value <= 6)
+        {
+            filtered = (filtered >> filter_shift) << value;     /* Keep the filter output */
+            filter_shift = value;
+        }
+        break;
+    case PAD_REG_SCAN_DELAY:
+        scan_delay = (unsigned int) value << 4;
+        break;
+    case PAD_REG_CLAMP:
+        if (value > pad_floor)
+            pad_clamp = value;
+        break;
+    case PAD_REG_FLOOR:
+        if (value < pad_clamp)
+            pad_floor = value;
+        break;
+    case PAD_REG_RECAL:
+        /* The filter output is the pad's offset from the old baseline */
+        base_capacitance += filtered >> filter_shift;
+        filtered = 0;
+        noise_sum = 0;
+        break;
+    }
+}
+
+unsigned int read_status(uint8_t item)
+{
+    switch (item)
+    {
+    case PAD_STAT_BASELINE:
+        return base_capacitance;
+    case PAD_STAT_NOISE:
+        return noise_sum >> NOISE_SHIFT;
+    case PAD_STAT_SCAN_RATE:
+        return scan_rate;
+    case PAD_STAT_NACKS:
+        return nack_count;
+    case PAD_STAT_STACK:
+        return stack_peak;
+    case PAD_STAT_CONFIG:
+        return filter_shift | ((scan_delay >> 4) << 8);
+    case PAD_STAT_LEVELS:
+        return pad_floor | ((unsigned int) pad_clamp << 8);
+    }
+    return 0;
+}
+
+void track_noise(void)
+{
+    /* Deviation of the raw reading from the filter output, untouched pad only */
+    int deviation = margin - (int) (filtered >> filter_shift);
+
+    if (deviation < 0)
+        deviation = -deviation;
+    if (deviation > NOISE_MAX)
+        deviation = NOISE_MAX;
+    noise_sum += deviation - (noise_sum >> NOISE_SHIFT);
+}
+
 long int scan_key(void)
 {
     measured = measure_key_capacitance();
     margin = measured - base_capacitance;
-    filtered += (margin - (filtered >> 4));
+    filtered += (margin - (filtered >> filter_shift));
     return filtered;
 }
 
@@ -77,6 +232,7 @@ void main(void)
     int i;
 
     WDTCTL = WDTPW | WDTHOLD;             /* Stop the watchdog */
+    stack_paint();
 
     /* Use the VLOCLK oscillator. This is important. If we leave the unused 32kHz
        oscillator running, its pins will not be free for sensing. */
@@ -123,8 +279,9 @@ void main(void)
     P1DIR |= BIT1;
     P1IES |= BIT1;
 
-    /* Drive Timer A from the SMCLK, in continuous mode */
-    TACTL = TASSEL_2 | MC_2 | ID_3;
+    /* Drive Timer A from the SMCLK, in continuous mode, undivided for the
+       finest capture resolution. The overflow interrupt times the scan rate. */
+    TACTL = TASSEL_2 | MC_2 | TAIE;
 
     /* Scan the keys quite a few times, to allow plenty of time for the
        MCLK and board conditions to stablise */
@@ -133,20 +290,27 @@ void main(void)
 
     /* Now we can use the current filtered key response as the base response.
        The shift allows for the filter gain. */
-    base_capacitance = filtered >> 4;
+    base_capacitance = filtered >> filter_shift;
     filtered = 0;
 
     for (;;)
     {
         scan_key();
-        to_host = filtered >> 4;
-        if (to_host < 0)
+        to_host = filtered >> (filter_shift + MEASURE_SHIFT);  /* Same scale as before */
+        if (to_host <= pad_floor)
+        {
+            track_noise();
             to_host = 0;
-        else if (to_host > 255)
+        }
+        else if (to_host >= pad_clamp)
+        {
             to_host = 255;
+        }
         send_to_host(to_host);
+        stack_peak = stack_high_water();
+        scans++;
         /* A little wait, so we don't output results too fast */
-        for (i = 0;  i < 1000;  i++)
+        for (i = 0;  i < scan_delay;  i++)
             _NOP();
     }
 }
@@ -172,7 +336,9 @@ __interrupt void port_2_interrupt(void)
 #pragma vector=TIMERA0_VECTOR
 __interrupt void timera0_interrupt(void)
 {
-    LPM3_EXIT;
+    TACCTL0 &= ~CCIE;                         /* One edge per measurement */
+    timer_count = TACCR0 - timer_count;       /* Edge time latched by the capture */
+    LPM3_EXIT;                                /* Exit from low power 3 or 0 */
 }
 
 #pragma vector=TIMERA1_VECTOR
@@ -181,9 +347,19 @@ __interrupt void timera1_interrupt(void)
     switch (TAIV)
     {
     case 2:
-        /* TACCR1 */
+        /* TACCR1: the capture timed out */
+        TACCTL1 &= ~CCIE;
         LPM3_EXIT;
         break;
+    case 10:
+        /* Overflow */
+        if (++overflows >= OVERFLOWS_PER_SEC)
+        {
+            overflows = 0;
+            scan_rate = scans;
+            scans = 0;
+        }
+        break;
     }
 }
 
@@ -197,12 +373,17 @@ __interrupt void watchdog_interrupt(void)
 
 /* ------------------------------- COMMUNICATIONS ---------------------- */
 
-const uint8_t SLV_Addr = 0x48;                      /* I2C slave address is 0x48 */
+const uint8_t SLV_Addr = PAD_I2C_ADDR;              /* I2C slave address is 0x48 */
 int8_t I2C_state = -2;                               /* I2C state tracking */
+uint8_t i2c_buf[4];                                 /* Bytes to send, or received */
+uint8_t i2c_len;
+uint8_t i2c_index;                                  /* Bytes (N)Acked so far */
+uint8_t i2c_read;                                   /* R/W bit of the transfer */
 
-void send_to_host(int data)
+void i2c_transfer(uint8_t read)
 {
-    host_data = data;
+    i2c_read = read;
+    i2c_index = 0;
     I2C_state = 0;
     USICTL1 |= USIIFG;                              /* Set flag and start communication */
     /* Wait until the I/O operation has completed */
@@ -211,6 +392,40 @@ void send_to_host(int data)
     while (I2C_state >= 0);
 }
 
+void send_to_host(int data)
+{
+    unsigned int value;
+
+    i2c_buf[0] = data;
+    i2c_len = 1;
+    if (++poll_count >= PAD_POLL_SCANS)
+    {
+        /* Piggyback the next status item on the pad level... */
+        value = read_status(status_item);
+        i2c_buf[1] = status_item;
+        i2c_buf[2] = value;
+        i2c_buf[3] = value >> 8;
+        i2c_len = 4;
+        if (++status_item > PAD_STAT_COUNT)
+            status_item = PAD_STAT_BASELINE;
+    }
+    i2c_transfer(FALSE);
+    if (poll_count >= PAD_POLL_SCANS)
+    {
+        /* ...and pick up any configuration change */
+        poll_count = 0;
+        read_config();
+    }
+}
+
+void read_config(void)
+{
+    i2c_len = 2;
+    i2c_transfer(TRUE);
+    if (i2c_index == 2)
+        apply_config(i2c_buf[0], i2c_buf[1]);
+}
+
 void usi_i2c_init(void)
 {
     P1OUT |= (BIT7 | BIT6);                         /* P1.6 & P1.7 are for I2C */
@@ -227,7 +442,7 @@ void usi_i2c_init(void)
 #pragma vector = USI_VECTOR
 __interrupt void USI_TXRX(void)
 {
-    switch (__even_in_range(I2C_state, 10))
+    switch (__even_in_range(I2C_state, 16))
     {
     case 0:
          /* Generate start condition & send address to slave */
@@ -235,7 +450,7 @@ __interrupt void USI_TXRX(void)
         USISRL = 0x00;                      /* Generate Start Condition... */
         USICTL0 |= (USIGE | USIOE);
         USICTL0 &= ~USIGE;
-        USISRL = SLV_Addr << 1;             /* ... and transmit address, R/W = 0 */
+        USISRL = (SLV_Addr << 1) | i2c_read;    /* ... and transmit address, R/W */
         USICNT = (USICNT & 0xE0) + 0x08;    /* Bit counter = 8, TX Address */
         I2C_state = 2;                      /* Go to next state: receive address (N)Ack */
         break;
@@ -251,15 +466,24 @@ __interrupt void USI_TXRX(void)
         if (USISRL & 0x01)
         {
             /* Nack received. Send stop... */
+            nack_count++;
             USISRL = 0x00;
             USICNT |=  0x01;                /* Bit counter = 1, SCL high, SDA low */
             I2C_state = 10;                 /* Go to next state: generate Stop */
             P1OUT |= 0x01;                  /* Turn on LED: error */
         }
+        else if (i2c_read)
+        {
+            /* Ack received, RX data from slave... */
+            USICTL0 &= ~USIOE;              /* SDA = input */
+            USICNT |=  0x08;                /* Bit counter = 8, start RX */
+            I2C_state = 12;                 /* Go to next state: store data, send (N)Ack */
+            P1OUT &= ~0x01;                 /* Turn off LED */
+        }
         else
         {
             /* Ack received, TX data to slave... */
-            USISRL = host_data;             /* Load data byte */
+            USISRL = i2c_buf[0];            /* Load data byte */
             USICNT |=  0x08;                /* Bit counter = 8, start TX */
             I2C_state = 6;                  /* Go to next state: receive data (N)Ack */
             P1OUT &= ~0x01;                 /* Turn off LED */
@@ -272,16 +496,20 @@ __interrupt void USI_TXRX(void)
         I2C_state = 8;                      /* Go to next state: check (N)Ack */
         break;
     case 8:
-        /* Process Data Ack/Nack & send Stop */
+        /* Process Data Ack/Nack & send next byte or Stop */
         USICTL0 |= USIOE;
         if (USISRL & 0x01)
         {
-            /* Nack received... */
-            /* TODO: Handle the NACK */
+            /* Nack received: the slave refused the byte, drop the rest */
+            nack_count++;
         }
-        else
+        else if (++i2c_index < i2c_len)
         {
-            /* Ack received */
+            /* Ack received, TX next data byte */
+            USISRL = i2c_buf[i2c_index];
+            USICNT |=  0x08;                /* Bit counter = 8, start TX */
+            I2C_state = 6;                  /* Go to next state: receive data (N)Ack */
+            break;
         }
         /* Send stop... */
         USISRL = 0x00;
@@ -296,6 +524,34 @@ __interrupt void USI_TXRX(void)
         I2C_state = -2;                     /* Reset state machine for next transmission */
         LPM0_EXIT;                          /* Exit active for next transfer */
         break;
+    case 12:
+        /* Store data byte & send Ack, or Nack after the last byte */
+        i2c_buf[i2c_index++] = USISRL;
+        USICTL0 |= USIOE;                   /* SDA = output */
+        if (i2c_index < i2c_len)
+        {
+            USISRL = 0x00;                  /* Ack: more to come */
+            I2C_state = 14;                 /* Go to next state: receive next byte */
+        }
+        else
+        {
+            USISRL = 0xFF;                  /* Nack: last byte */
+            I2C_state = 16;                 /* Go to next state: prepare stop */
+        }
+        USICNT |= 0x01;                     /* Bit counter = 1, send (N)Ack bit */
+        break;
+    case 14:
+        /* Receive next data byte */
+        USICTL0 &= ~USIOE;                  /* SDA = input */
+        USICNT |= 0x08;                     /* Bit counter = 8, start RX */
+        I2C_state = 12;                     /* Go to next state: store data, send (N)Ack */
+        break;
+    case 16:
+        /* Prepare stop condition */
+        USISRL = 0x00;
+        USICNT |=  0x01;                    /* Bit counter = 1, SCL high, SDA low */
+        I2C_state = 10;                     /* Go to next state: generate stop */
+        break;
     }
     USICTL1 &= ~USIIFG;                     /* Clear pending flag */
 }
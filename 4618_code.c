@@ -21,6 +21,8 @@
 
 #include <msp430xG46x.h>
 #include <definitions.h>
+#include <morse.h>
+#include <pad_i2c.h>
 
 #define FALSE 0
 #define TRUE (!FALSE)
@@ -28,19 +30,17 @@
 #define SW2 BIT1&P1IN
 #define SW1 BIT0&P1IN
 
-char isSending = 0;
+volatile char isSending = 0;
+volatile char inputPending = FALSE;     // Terminal input for the main loop, see processInput()
 
 #define maxCharacters 25
 
-unsigned long int id;
 char pos =0;
+char inPos = 0;                         // Terminal line position (pos is the touch pad's)
 char released = FALSE;
 char INCOMING_STATE = FALSE;
 
-#define dotDelay for (id=0;id<10000 ; id++)		// 0.1 sec delay
-#define lineDelay for (id=0;id<30000 ; id++)	// 0.3 sec delay
-
-char morseCode = 0;
+uint8_t morseCode = 0;
 
 char touchMsg [5]= {0};
 char inputMsg [maxCharacters] = {0};
@@ -67,6 +67,35 @@ char inputMsg [maxCharacters] = {0};
 #define CHAR_F              (SEG_a|SEG_e|SEG_f|SEG_g)
 #define CHAR_MINUS          (SEG_g)
 
+//The rest of the alphabet, as close as 7 segments get. Some
+//letters share a pattern with a digit (S/5, Z/2) or another letter (X/H).
+#define CHAR_G              (SEG_a|SEG_c|SEG_d|SEG_e|SEG_f)
+#define CHAR_H              (SEG_b|SEG_c|SEG_e|SEG_f|SEG_g)
+#define CHAR_I              (SEG_e|SEG_f)
+#define CHAR_J              (SEG_b|SEG_c|SEG_d|SEG_e)
+#define CHAR_K              (SEG_a|SEG_c|SEG_e|SEG_f|SEG_g)
+#define CHAR_L              (SEG_d|SEG_e|SEG_f)
+#define CHAR_M              (SEG_a|SEG_b|SEG_c|SEG_e|SEG_f)
+#define CHAR_N              (SEG_c|SEG_e|SEG_g)
+#define CHAR_O              (SEG_c|SEG_d|SEG_e|SEG_g)
+#define CHAR_P              (SEG_a|SEG_b|SEG_e|SEG_f|SEG_g)
+#define CHAR_Q              (SEG_a|SEG_b|SEG_c|SEG_f|SEG_g)
+#define CHAR_R              (SEG_e|SEG_g)
+#define CHAR_S              CHAR_5
+#define CHAR_T              (SEG_d|SEG_e|SEG_f|SEG_g)
+#define CHAR_U              (SEG_b|SEG_c|SEG_d|SEG_e|SEG_f)
+#define CHAR_V              (SEG_c|SEG_d|SEG_e)
+#define CHAR_W              (SEG_b|SEG_d|SEG_f)
+#define CHAR_X              CHAR_H
+#define CHAR_Y              (SEG_b|SEG_c|SEG_d|SEG_f|SEG_g)
+#define CHAR_Z              CHAR_2
+
+//Keying indicator: DOT and LINE as typed on the touch pad, and the
+//element currently held down
+#define CHAR_DOT            (SEG_h)
+#define CHAR_LINE           (SEG_d)
+#define CHAR_KEYDOWN        (SEG_g)
+
 #define SEG_a       0x01
 #define SEG_b       0x02
 #define SEG_c       0x04
@@ -98,6 +127,27 @@ const uint8_t lcd_digit_table[18] =
     CHAR_SPACE
 };
 
+const uint8_t lcd_alpha_table[26] =
+{
+    CHAR_A, CHAR_B, CHAR_C, CHAR_D, CHAR_E, CHAR_F, CHAR_G,
+    CHAR_H, CHAR_I, CHAR_J, CHAR_K, CHAR_L, CHAR_M, CHAR_N,
+    CHAR_O, CHAR_P, CHAR_Q, CHAR_R, CHAR_S, CHAR_T, CHAR_U,
+    CHAR_V, CHAR_W, CHAR_X, CHAR_Y, CHAR_Z
+};
+
+// LCD layout (positions as used by LCDchar)
+// 1-5: last decoded characters, scrolling left. While a character is
+//      being keyed they show its DOT/LINE elements instead.
+// 6-7: keying speed in WPM
+#define LCD_TEXT_POS        1
+#define LCD_TEXT_LEN        5
+#define LCD_WPM_POS         6
+
+char lcdText[LCD_TEXT_LEN];                 // Decoded characters, oldest first
+char keyDown = FALSE;                       // Capacitive pad currently pressed
+volatile char lcdDirty = TRUE;              // Set by the ISRs, cleared by LCDupdate()
+int dotAvg = 0;                             // Average DOT length, 1/16 of a TIMERA tick
+
 void init_lcd(void)
 {
     int i;
@@ -123,8 +173,21 @@ void init_lcd(void)
 
 void LCDchar(int ch, int pos)
 {
-    /* Put a segment pattern at a specified position on the LCD display */
-    LCDMEM[9 - pos] = ch;
+    /* Put a segment pattern at a specified position on the LCD display.
+       Unchanged digits are not rewritten. */
+    if (LCDMEM[9 - pos] != ch)
+        LCDMEM[9 - pos] = ch;
+}
+
+uint8_t LCDfont(char c)
+{
+    /* Segment pattern for a character of the Morse Code table */
+    if (c >= '0' && c <= '9')
+        return lcd_digit_table[c - '0'];
+    c = tolower(c);
+    if (c >= 'a' && c <= 'z')
+        return lcd_alpha_table[c - 'a'];
+    return CHAR_MINUS;
 }
 
 void LCDdigit(uint16_t val, int pos)
@@ -143,6 +206,58 @@ void LCDdec(uint16_t val, int pos)
     }
 }
 
+void LCDpush(char c)
+{
+    /* Scroll a decoded character into the text view */
+    char i;
+    for (i = 0; i < LCD_TEXT_LEN-1; i++)
+        lcdText[i] = lcdText[i+1];
+    lcdText[LCD_TEXT_LEN-1] = c;
+    lcdDirty = TRUE;
+}
+
+void LCDupdate(void)
+{
+    /* Redraw from the current keying state. Only called when lcdDirty is set. */
+    char i;
+    int wpm;
+
+    lcdDirty = FALSE;
+    if (touchMsg[0] != 0 || keyDown == TRUE)
+    {
+        char shown = FALSE;
+        for (i = 0; i < LCD_TEXT_LEN; i++)
+        {
+            if (touchMsg[i] == DOT)
+                LCDchar(CHAR_DOT, LCD_TEXT_POS + i);
+            else if (touchMsg[i] == LINE)
+                LCDchar(CHAR_LINE, LCD_TEXT_POS + i);
+            else if (keyDown == TRUE && shown == FALSE)
+            {
+                LCDchar(CHAR_KEYDOWN, LCD_TEXT_POS + i);  // Element being keyed
+                shown = TRUE;
+            }
+            else
+                LCDchar(CHAR_SPACE, LCD_TEXT_POS + i);
+        }
+    }
+    else
+    {
+        for (i = 0; i < LCD_TEXT_LEN; i++)
+            LCDchar(lcdText[i] ? LCDfont(lcdText[i]) : CHAR_SPACE, LCD_TEXT_POS + i);
+    }
+
+    // PARIS timing: a DOT is 1200/WPM ms, TIMERA ticks are 100ms
+    wpm = dotAvg ? 192 / dotAvg : 0;
+    if (wpm > 99)
+        wpm = 99;
+    if (wpm)
+    {
+        LCDchar(lcd_digit_table[wpm/10], LCD_WPM_POS);
+        LCDchar(lcd_digit_table[wpm%10], LCD_WPM_POS + 1);
+    }
+}
+
 void configure_uart_usci0(void)
 {
     /* Configure USCI0A as a UART */
@@ -172,40 +287,122 @@ void configure_i2c_usci0(void)
     UCB0CTL1 |= UCSWRST;                    /* Enable SW reset */
 
     UCB0CTL0 = UCMODE_3 | UCSYNC;           /* I2C Slave, synchronous mode */
-    UCB0I2COA = 0x48;                       /* Own Address */
+    UCB0I2COA = PAD_I2C_ADDR;               /* Own Address */
     UCB0CTL1 &= ~UCSWRST;                   /* Clear SW reset, resume operation */
     UCB0I2CIE |= (UCSTPIE | UCSTTIE);       /* Enable STT and STP interrupt */
-    IE2 |= UCB0RXIE;                        /* Enable RX interrupt */
+    IE2 |= UCB0RXIE | UCB0TXIE;             /* Enable RX and TX (configuration reads) interrupt */
 }
 
 uint8_t xxx = 0;
 
-void send_DMA( char * char_arr, int size)
+// ---------------------------------- TX RING ----------------------------------
+// All UART output is queued here and sent from the USCI_A0 TX interrupt, so
+// no code waits on the line (the RX interrupt least of all). XON/XOFF go out
+// ahead of the ring. A backlog past TX_HIGH counts toward XOFF, see
+// flowControl().
+#define TX_SIZE         64
+#define TX_HIGH         48              // XOFF: output can't keep up with input
+#define TX_LOW          16
+
+char txRing[TX_SIZE];
+char txHead = 0;
+char txTail = 0;
+volatile char txCount = 0;
+char txFlow = 0;                        // XON/XOFF to send next, 0 if none
+
+void txNext()
 {
-    DMACTL0 = DMA0TSEL_4;               // DMAREQ, software trigger, TX is ready
-    DMA0SA = (int)char_arr;             // Source block address
-    DMA0DA = (int)&UCA0TXBUF;           // Destination single address
-    DMA0SZ = size;                      // Length of the String
-    DMA0CTL = DMASRCINCR_3 + DMASBDB + DMALEVEL; // Increment src address
-    DMA0CTL |= DMAIE;                   // Interrupt Enable DMA
+    // Send one byte, TXBUF is free. Called from the TX interrupt.
+    if(txFlow)
+    {
+        UCA0TXBUF = txFlow;
+        txFlow = 0;
+    }
+    else if(txCount > 0)
+    {
+        UCA0TXBUF = txRing[txTail];
+        txTail = (txTail + 1) % TX_SIZE;
+        txCount--;
+    }
+    if(txFlow == 0 && txCount == 0)
+        IE2 &= ~UCA0TXIE;               // Nothing left
+    flowControl();                      // XON once the backlog has gone
+}
 
-    DMA0CTL |= DMAEN;                   // Enable DMA transfer
+void putChar(char c)
+{
+    unsigned int gie = __get_SR_register() & GIE;
+    while(gie && txCount >= TX_SIZE);   // Main loop: the TX interrupt makes room
+    _DINT();
+    while(txCount >= TX_SIZE)           // In an ISR: make room by hand
+    {
+        while(!(IFG2&UCA0TXIFG));
+        txNext();
+    }
+    txRing[txHead] = c;
+    txHead = (txHead + 1) % TX_SIZE;
+    txCount++;
+    IE2 |= UCA0TXIE;
+    flowControl();
+    if(gie)
+        _EINT();
+}
+
+void putBytes(const char * s, int size)
+{
+    while(size-- > 0)
+        putChar(*s++);
 }
 
-void sendTitle ()                       // Send Morse Code Char Title using DMA
+void sendTitle ()                       // Send Morse Code Char Title
 {
-    send_DMA(title0, sizeof(title0));
+    putBytes(title0, sizeof(title0));
+}
+
+// -------------------------------- STACK USAGE --------------------------------
+// The unused part of the stack is painted at reset. The deepest point reached
+// since then (ISR nesting included, e.g. TA0_ISR -> morseToLetter -> putBytes)
+// is found by looking for the first byte that has been overwritten.
+#define STACK_PAINT 0xA5
+
+#if defined(__IAR_SYSTEMS_ICC__)
+#pragma segment="CSTACK"
+#define STACK_START ((uint8_t *)__segment_begin("CSTACK"))
+#define STACK_END   ((uint8_t *)__segment_end("CSTACK"))
+#else
+extern uint8_t _stack;                      // TI linker: .stack section bounds
+extern uint8_t __STACK_END;
+#define STACK_START (&_stack)
+#define STACK_END   (&__STACK_END)
+#endif
+
+void stackPaint(void)
+{
+    uint8_t * p = STACK_START;
+    uint8_t * sp = (uint8_t *)__get_SP_register();
+    while(p < sp - 2)                       // Leave this function's frame alone
+        *p++ = STACK_PAINT;
+}
+
+unsigned int stackHighWater(void)
+{
+    uint8_t * p = STACK_START;
+    while(p < STACK_END && *p == STACK_PAINT)
+        p++;
+    return STACK_END - p;                   // Bytes used at the deepest point
 }
 
 void main(void)
 {
     WDTCTL = WDTPW | WDTHOLD;               /* Stop watchdog */
+    stackPaint();
 
     configure_uart_usci0();
     configure_i2c_usci0();
     init_lcd();
 
     sendTitle();					// Send title
+    putBytes(prompt,sizeof(prompt));
 
     // Buzzer setup
     P3SEL |= BIT5;                  // P3 BIT 5 set to TB4
@@ -223,6 +420,11 @@ void main(void)
     // TIMERA
     timerASetUp();
 
+#if FLOW_RTS
+    RTS_DIR |= RTS_PIN;             // RTS output, low: ready to receive
+    RTS_OUT &= ~RTS_PIN;
+#endif
+
     // WDT  Setup and Start
     IE1 |= WDTIE;                   // Enable WDT interrupt
     P1IE |= BIT0+BIT1;              // P1.0,P1.1 interrupt enabled (SW1,SW2)
@@ -233,9 +435,22 @@ void main(void)
     for (;;)
     {
 #if 1
-        /* Normal operation */
-        LPM0;
-        LCDdec(xxx, 3);
+        /* Normal operation: sleep until an ISR marks the display dirty or
+           leaves terminal input. The flags are checked with interrupts off:
+           an LPM0_EXIT from an ISR that ran during the last pass only woke
+           us while we were awake already, so it must not be slept through. */
+        _DINT();
+        if (!lcdDirty && !inputPending)
+            __bis_SR_register(LPM0_bits + GIE); // Sleep, interrupts back on
+        else
+            _EINT();
+        if (inputPending)
+        {
+            inputPending = FALSE;
+            processInput();
+        }
+        if (lcdDirty)
+            LCDupdate();
 
 #else
         Checking out the host interface
@@ -249,149 +464,765 @@ void main(void)
     }
 }
 
-void setMorseCode(char * c, int size)
+void morseToLetter (char p)
+{
+    int i = morseDecode(touchMsg, p);                  // Look up received MorseCode
+    if(i >= 0)
+    {
+        LCDpush(MC_chars[i]);                           // Scroll into LCD text view
+        putBytes(incomingChar,sizeof(incomingChar));
+        putChar(MC_chars[i]);                           // Send Corresponding Character
+    }
+    else
+    {
+        LCDpush('-');
+        putBytes(specChar,sizeof(specChar));            // MSG: char not in MORSE CODE Table
+        putBytes(NLprompt,sizeof(NLprompt));
+    }
+    // clear touchMSg array
+    for (i=0; i<5;i++)
+    {
+        touchMsg[i] = 0;
+    }
+
+    // Enable Transmission through Serial terminal
+    isSending = FALSE;
+
+}
+
+uint8_t letterToMorse (char c)
 {
-    // morseCode Op-Code
-    // BYTE [XXX43210]
-    // XXX is LENGTH of letter in . & _
-    // 43210 is msg, order of execution from BIT4 to BIT4 + LENGTH-1
-    // BIT at 0 if DOT
-    // BIT at 1 if LINE
+    // Op-Code of c, 0 if c is not in the table. morseCode is left alone: it
+    // is the letter the WDT is playing while the main loop encodes.
+    int i = morseIndex(c);                              // find c in Morse Code Chars Array
+    if(i >= 0)
+        return morseEncode(MC_code[i],MC_code_size[i]); // Create Morse Code Op-Code Byte
+    return 0;
+}
+
+// ------------------------------- MESSAGE STORE -------------------------------
+// Canned messages (CQ, contest exchange, beacon text) kept in info memory as
+// morseCode Op-Code bytes, so playback needs neither the terminal nor the
+// letterToMorse lookup. Two macros per 64 byte info segment, D to B
+// (segment A is left alone).
+// Macro layout: [LENGTH][Op-Code 0]...[Op-Code LENGTH-1], LENGTH 0xFF = empty
+#define MACRO_COUNT     6
+#define MACRO_SIZE      32
+#define MACRO_SEG_SIZE  64
+#define MACRO_BASE      ((uint8_t *)0x1000)
+#define MACRO(n)        (MACRO_BASE + (n)*MACRO_SIZE)
+
+const char cmdUsage[] = "\r\n!s<n><text> store, !l list, !p<n> play, !b<n><sec> beacon, !b stop, !m memory, !u<text> urgent, !q queue"
+                        "\r\n!f<n> pad filter, !d<n> pad scan delay, !c<n> pad press level, !z<n> pad release level, !r pad recalibrate, !i pad status";
+
+char beaconMacro = 0;
+unsigned int beaconInterval = 0;        // Seconds between beacons, 0 = off
+unsigned int beaconCount = 0;
+
+void putString(const char * s)
+{
+    while(*s)
+        putChar(*s++);
+}
+
+void putNum(unsigned long n)
+{
+    char digits[10];
+    char k = 0;
+    do
+    {
+        digits[k++] = '0' + n%10;
+        n /= 10;
+    } while(n);
+    while(k)
+        putChar(digits[--k]);
+}
+
+unsigned int parseNum(const char * s)
+{
+    unsigned int n = 0;
+    while(*s >= '0' && *s <= '9')
+        n = n*10 + (*s++ - '0');
+    return n;
+}
+
+char morseToChar(uint8_t code)
+{
+    // Inverse of letterToMorse, used to list stored macros
+    char i;
+    for(i=0; i<MC_COUNT; i++)
+    {
+        if(morseEncode(MC_code[i],MC_code_size[i]) == code)
+            return MC_chars[i];
+    }
+    return '?';
+}
+
+void storeMacro(char n, const char * text)
+{
+    // Info flash is erased a whole segment at a time: keep a RAM copy of the
+    // segment, replace this macro in it and program it back.
+    uint8_t seg[MACRO_SEG_SIZE];
+    uint8_t * flash = MACRO_BASE + (n/2)*MACRO_SEG_SIZE;
+    uint8_t * macro = seg + (n%2)*MACRO_SIZE;
     char k;
-    char p = BIT4;
-    for(k=0; k < size-1; k++)
+
+    memcpy(seg, flash, MACRO_SEG_SIZE);
+    memset(macro, 0xFF, MACRO_SIZE);
+    for(k=0; text[k] != 0 && k < MACRO_SIZE-1; k++)
+        macro[k+1] = letterToMorse(text[k]);    // Pre-encoded Op-Code
+    macro[0] = k;
+
+    FCTL2 = FWKEY + FSSEL_2 + FN1;      // SMCLK/3 = ~350kHz flash timing generator
+    FCTL3 = FWKEY;                      // Unlock
+    FCTL1 = FWKEY + ERASE;
+    *flash = 0;                         // Dummy write erases the segment
+    FCTL1 = FWKEY + WRT;
+    for(k=0; k<MACRO_SEG_SIZE; k++)
+        flash[k] = seg[k];
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;               // Lock
+}
+
+void listMacros()
+{
+    char n, k;
+    for(n=0; n<MACRO_COUNT; n++)
+    {
+        putString("\r\n");
+        putChar('0' + n);
+        putString(": ");
+        if(MACRO(n)[0] < MACRO_SIZE)
+        {
+            for(k=0; k<MACRO(n)[0]; k++)
+                putChar(morseToChar(MACRO(n)[k+1]));
+        }
+    }
+}
+
+// ------------------------------- FLOW CONTROL -------------------------------
+// The RX interrupt only puts received characters into a small ring buffer.
+// The main loop takes them out (echoed, edited into inputMsg) only while the
+// terminal is not blocked by touch pad input, and ENTER (of text or !p) is
+// only taken once the playback queue has a free slot. When the ring fills
+// past RX_HIGH, the TX ring past TX_HIGH or the main loop can't take input
+// (flash erase) the host gets XOFF (and RTS is dropped, if wired). Once all
+// of them are low again it gets XON, so a host can stream at full line rate
+// and the board paces it without losing characters.
+#define RX_SIZE         32
+#define RX_HIGH         16              // XOFF: room left for the host's overrun
+#define RX_LOW          4               // XON
+
+#define XON             0x11
+#define XOFF            0x13
+
+// Optional RTS on a spare GPIO, low = host may send
+#define FLOW_RTS        0
+#define RTS_DIR         P2DIR
+#define RTS_OUT         P2OUT
+#define RTS_PIN         BIT6
+
+char rxRing[RX_SIZE];
+char rxHead = 0;
+char rxTail = 0;
+volatile char rxCount = 0;
+char rxStopped = FALSE;                 // XOFF sent
+char rxHeld = FALSE;                    // Main loop can't take input for a while
+unsigned int rxOverruns = 0;            // Characters lost: ring full (host ignored XOFF) or UART overrun
+
+void flowControl()
+{
+    // Interrupts off (ISRs, putChar, or the main loop with _DINT)
+    if(rxStopped == FALSE && (rxHeld || rxCount >= RX_HIGH || txCount >= TX_HIGH))
     {
-        if(c[k] == '_')
-            morseCode |= (BIT4 >> k);     // set bit if LINE, Shift right by K
+        rxStopped = TRUE;
+#if FLOW_RTS
+        RTS_OUT |= RTS_PIN;
+#endif
+        txFlow = XOFF;                  // Goes out ahead of the TX ring
+        IE2 |= UCA0TXIE;
     }
-    switch (size-1)                       // Skip NULL END char
-    {  // Set Bits for size
-        case 1:morseCode |=BIT5; break;
-        case 2:morseCode |=BIT6; break;
-        case 3:morseCode |=BIT5+BIT6; break;
-        case 4:morseCode |=BIT7; break;
-        case 5:morseCode |=BIT7+BIT5; break;
+    else if(rxStopped == TRUE && !rxHeld && rxCount <= RX_LOW && txCount <= TX_LOW)
+    {
+        rxStopped = FALSE;
+#if FLOW_RTS
+        RTS_OUT &= ~RTS_PIN;
+#endif
+        txFlow = XON;
+        IE2 |= UCA0TXIE;
     }
 }
 
-void morseToLetter (char p)
+void holdInput(char hold)
+{
+    // Stop the host before the CPU stalls (flash erase), so nothing is
+    // received meanwhile. Waits until the XOFF has left the UART.
+    _DINT();
+    rxHeld = hold;
+    flowControl();
+    _EINT();
+    while(hold && ((IE2 & UCA0TXIE) || (UCA0STAT & UCBUSY)));
+}
+
+char endsLine(char c)
 {
-    char found = FALSE;
-    char i=0;
-    int size = sizeof(MC_chars);
-    while(i< size && found==FALSE)
+    // Would c send inputMsg to the playback queue?
+    if(inputMsg[0] == '!' && tolower(inputMsg[1]) != 'p')
+        return FALSE;                   // Other commands don't wait, !u has QUEUE_RESERVED
+    return c==13 || (inPos >= maxCharacters-1 && (isalnum(c) || c==8));
+}
+
+// ------------------------------ TOUCH PAD LINK ------------------------------
+// The F2013 reads a [register][value] pair from us every PAD_POLL_SCANS scans
+// (see pad_i2c.h), so the pad is tuned from the terminal while it runs: the
+// !f !d !c !z !r commands queue register writes here. Every PAD_POLL_SCANS
+// frames also carry one status item after the pad level, kept in padStatus
+// for !i.
+#define PAD_CFG_SIZE    4
+
+uint8_t padCfg[PAD_CFG_SIZE][2];        // Register writes waiting for a read
+char padCfgHead = 0;
+char padCfgCount = 0;
+uint8_t padTx[2];                       // Pair being read by the F2013
+char padTxIndex = 0;
+uint8_t padRx[4];                       // [pad][id][lo][hi]
+char padRxIndex = 0;
+unsigned int padStatus[PAD_STAT_COUNT+1];   // Last value of each status item
+
+char padConfig(uint8_t reg, uint8_t value)
+{
+    // Main loop, the F2013's reads take from the other end in the TX interrupt
+    char k, ok = FALSE;
+    _DINT();
+    if(padCfgCount < PAD_CFG_SIZE)
     {
-        char mc_size = MC_code_size[i];
-        if(mc_size == (p+1))                            // Check Size of MorseCode to narrow down characters
+        k = (padCfgHead + padCfgCount) % PAD_CFG_SIZE;
+        padCfg[k][0] = reg;
+        padCfg[k][1] = value;
+        padCfgCount++;
+        ok = TRUE;
+    }
+    _EINT();
+    return ok;
+}
+
+char padCommand(uint8_t reg, unsigned int min, unsigned int max)
+{
+    // "!<command><value>"
+    unsigned int value = parseNum(&inputMsg[2]);
+    if(!isdigit(inputMsg[2]) || value < min || value > max)
+        return FALSE;
+    return padConfig(reg, value);
+}
+
+uint8_t padTxByte()
+{
+    // Next byte of a configuration read, PAD_REG_NOP if nothing is queued
+    if(padTxIndex == 0)
+    {
+        padTx[0] = padTx[1] = PAD_REG_NOP;
+        if(padCfgCount > 0)
         {
-            if(strcmp(MC_code[i],touchMsg)==0)          // Check if MorseCode[i] == received MorseCode[i]
-            {
-                send_DMA(incomingChar,sizeof(incomingChar));
-                found = TRUE;							// Stop searching if FOUND
-                while(!(IFG2&UCA0TXIFG));               // Wait until TXBUF is free
-                UCA0TXBUF = MC_chars[i];                // Send Corresponding Character
-            }
+            padTx[0] = padCfg[padCfgHead][0];
+            padTx[1] = padCfg[padCfgHead][1];
+            padCfgHead = (padCfgHead + 1) % PAD_CFG_SIZE;
+            padCfgCount--;
         }
-        i++;
     }
-    if(found == 0)
-        send_DMA(specChar,sizeof(specChar));            // MSG: char not in MORSE CODE Table
-    // clear touchMSg array
-    for (i=0; i<5;i++)
+    if(padTxIndex >= sizeof(padTx))
+        return PAD_REG_NOP;             // Master asked for more than the pair
+    return padTx[padTxIndex++];
+}
+
+void padLinkState()
+{
+    // STOP/START of a frame. Checked from both USCI vectors: the TX vector
+    // (data) has the higher priority and may see a new frame's first byte
+    // before the RX vector has seen its START.
+    if(UCB0STAT & UCSTPIFG)
     {
-        touchMsg[i] = 0;
+        if(padRxIndex == sizeof(padRx) && padRx[1] >= 1 && padRx[1] <= PAD_STAT_COUNT)
+            padStatus[padRx[1]] = padRx[2] | (padRx[3] << 8);
+        UCB0STAT &= ~UCSTPIFG;
+    }
+    if(UCB0STAT & UCSTTIFG)
+    {
+        padRxIndex = 0;
+        padTxIndex = 0;
+        UCB0STAT &= ~UCSTTIFG;
     }
+}
 
-    // Enable Transmission through Serial terminal
-    isSending = FALSE;
+void showPadStatus()
+{
+    putString("\r\nPad baseline ");
+    putNum(padStatus[PAD_STAT_BASELINE]);
+    putString(", noise ");
+    putNum(padStatus[PAD_STAT_NOISE]);
+    putString(", ");
+    putNum(padStatus[PAD_STAT_SCAN_RATE]);
+    putString(" scans/s, nacks ");
+    putNum(padStatus[PAD_STAT_NACKS]);
+    putString(", stack ");
+    putNum(padStatus[PAD_STAT_STACK]);
+    putString("\r\nfilter ");
+    putNum(padStatus[PAD_STAT_CONFIG] & 0xFF);
+    putString(", scan delay ");
+    putNum(padStatus[PAD_STAT_CONFIG] >> 8);
+    putString(", press ");
+    putNum(padStatus[PAD_STAT_LEVELS] >> 8);
+    putString(", release ");
+    putNum(padStatus[PAD_STAT_LEVELS] & 0xFF);
+}
+
+// ------------------------------ PLAYBACK QUEUE ------------------------------
+// Messages wait in a small queue and are played one element at a time from
+// the WDT interval interrupt, so the CPU sleeps between elements and the
+// terminal stays live during playback. At every character boundary the
+// highest priority message is picked (oldest first within a priority), so
+// an urgent message preempts the current one after its current letter and
+// the interrupted message resumes where it stopped. The last slot is kept
+// for urgent messages, so an alert never waits for a slot to free up.
+#define QUEUE_SIZE      6
+#define QUEUE_RESERVED  1               // Slots only PRIO_URGENT may take
 
+#define PRIO_BEACON     0
+#define PRIO_NORMAL     1
+#define PRIO_URGENT     2
+
+#define PLAY_UNIT       6               // WDT_ADLY_16 ticks per DOT (~0.1 sec)
+
+#define PHASE_TONE      0               // Buzzer on for a DOT or LINE
+#define PHASE_GAP       1               // space between letter parts
+#define PHASE_LETTER    2               // space between two letters
+
+typedef struct
+{
+    uint8_t codes[maxCharacters];       // Op-Codes of terminal text
+    const uint8_t * src;                // codes, or a macro in flash
+    char len;
+    char next;                          // Next Op-Code to play
+    char prio;
+    char used;
+    unsigned int seq;                   // Arrival order
+    unsigned int queuedAt;              // playClock when queued
+} message_t;
+
+const char queueFull[] = "\r\nQueue full, message dropped";
+
+message_t queue[QUEUE_SIZE];
+int8_t playSlot = -1;                   // Message being played, -1 if idle
+char playElement = 0;
+char playPhase = PHASE_LETTER;
+char playTicks = 0;
+unsigned int playClock = 0;             // WDT ticks while playing
+unsigned int queueSeq = 0;
+
+// Statistics for "!q"
+char queueDepth = 0;
+char queueMaxDepth = 0;
+unsigned int statPlayed = 0;
+unsigned int statStarted = 0;           // Messages that got their first letter
+unsigned int statPreempted = 0;
+unsigned long statWaitSum = 0;          // WDT ticks from queued to first letter
+unsigned int statWaitMax = 0;
+
+// start WDT to play the queue
+void playMorseCode ()
+{
+    if(playSlot < 0 && (WDTCTL & WDTHOLD))
+    {
+        playPhase = PHASE_LETTER;
+        playTicks = 1;
+        WDTCTL = WDT_ADLY_16;           // 15.6ms interval
+    }
 }
 
-void letterToMorse (char c)
+char makeRoom(char prio)
 {
-    c = tolower(c);
-    int size = sizeof(MC_chars);
+    // Is there a free slot for prio? An urgent message gets the reserved
+    // slot, and if another urgent message holds that, a waiting beacon's.
     char i;
-    for(i=0;i< size;i++)
+    if(prio != PRIO_URGENT)
+        return queueDepth < QUEUE_SIZE - QUEUE_RESERVED;
+    if(queueDepth < QUEUE_SIZE)
+        return TRUE;
+    for(i=0; i<QUEUE_SIZE; i++)
     {
-        if(c == MC_chars[i])                            // find c in Morse Code Chars Array
+        if(queue[i].used && queue[i].prio == PRIO_BEACON && i != playSlot)
         {
-            setMorseCode(MC_code[i],MC_code_size[i]);   // Create Morse Code Op-Code Byte
-            break;
+            queue[i].used = FALSE;      // Beacon comes round again anyway
+            queueDepth--;
+            return TRUE;
         }
     }
+    return FALSE;
 }
 
-// start WDT to play MorseCode msg
-void playMorseCode ()
+int8_t enqueue(const uint8_t * src, char len, char prio)
 {
-    WDTCTL = WDT_ADLY_250;              		// 250ms interval (default)
+    // Returns the queue slot, -1 if the queue is full
+    char i;
+    if(len == 0 || !makeRoom(prio))
+        return -1;
+    for(i=0; i<QUEUE_SIZE; i++)
+    {
+        if(queue[i].used == FALSE)
+        {
+            queue[i].src = src ? src : queue[i].codes;
+            queue[i].len = len;
+            queue[i].next = 0;
+            queue[i].prio = prio;
+            queue[i].seq = queueSeq++;
+            queue[i].queuedAt = playClock;
+            queue[i].used = TRUE;
+            if(++queueDepth > queueMaxDepth)
+                queueMaxDepth = queueDepth;
+            playMorseCode();
+            return i;
+        }
+    }
+    return -1;
 }
 
-// Plays morse code on Buzzer
-#pragma vector=WDT_VECTOR
-__interrupt void watchdog_timer(void)
+int8_t enqueueText(const char * text, char prio)
 {
-    char k = 0;
-    send_DMA(sending,sizeof(sending));          // Print "Sending Morse Code..."
-    while(inputMsg[k] != 0)                     // Parse Every Char of the message
+    // Encode terminal text, then copy it into a free slot. Main loop only:
+    // the slot is taken with interrupts off, so the WDT and a beacon can't
+    // get at it half filled.
+    uint8_t codes[maxCharacters];
+    int8_t i;
+    char k;
+    for(k=0; text[k] != 0 && k < maxCharacters; k++)
+        codes[k] = letterToMorse(text[k]);
+    _DINT();
+    i = enqueue(0, k, prio);
+    if(i >= 0)
+        memcpy(queue[i].codes, codes, k);
+    _EINT();
+    return i;
+}
+
+int8_t queueBest()
+{
+    int8_t i, best = -1;
+    for(i=0; i<QUEUE_SIZE; i++)
     {
-        letterToMorse(inputMsg[k]);             // Initiate letterToMorseConversion
-        char size = morseCode >> 5;             // Shift 5 bits to get size, Last MSB bits
-        int i;
-        for (i=0; i<size ; i++)
+        if(queue[i].used && (best < 0 || queue[i].prio > queue[best].prio ||
+           (queue[i].prio == queue[best].prio && (int)(queue[i].seq - queue[best].seq) < 0)))
+            best = i;
+    }
+    return best;
+}
+
+void buzzerOn()
+{
+    P3DIR |= BIT5;                      // Buzzer on
+    P5OUT |= BIT1;                      // Led4 on
+}
+
+void buzzerOff()
+{
+    P5OUT &= ~BIT1;                     // Led4 off
+    P3DIR &= ~BIT5;                     // Buzzer off
+}
+
+void nextLetter()
+{
+    // Character boundary: pick the message to continue with
+    int8_t best = queueBest();
+    message_t * m;
+
+    if(best < 0)
+    {
+        resetMorseBuzzer();
+        return;
+    }
+    m = &queue[best];
+    if(best != playSlot)
+    {
+        if(playSlot >= 0)
+            statPreempted++;
+        if(m->next == 0)
         {
-            P3DIR |= BIT5;                      // Buzzer on
-            P5OUT |= BIT1;                      // Led4 on
+            unsigned int wait = playClock - m->queuedAt;
+            statStarted++;
+            statWaitSum += wait;
+            if(wait > statWaitMax)
+                statWaitMax = wait;
+            putBytes(sending,sizeof(sending));  // Print "Sending Morse Code..."
+        }
+        playSlot = best;
+    }
+    morseCode = m->src[m->next++];
+    playElement = 0;
+    if(morseSize(morseCode) == 0)
+    {
+        playPhase = PHASE_GAP;          // Nothing to play, go to next letter
+        playTicks = 1;
+        return;
+    }
+    buzzerOn();
+    playPhase = PHASE_TONE;
+    playTicks = (morseElement(morseCode, 0) == LINE) ? 3*PLAY_UNIT : PLAY_UNIT;
+}
+
+char startMacro(char n, char prio)
+{
+    // Queue a stored macro, played directly from flash
+    if(n >= MACRO_COUNT || MACRO(n)[0] == 0 || MACRO(n)[0] >= MACRO_SIZE)
+        return FALSE;
+    return enqueue(MACRO(n) + 1, MACRO(n)[0], prio) >= 0;
+}
+
+char macroQueued(char n)
+{
+    // Queued macros are played from flash: storeMacro() must not rewrite them
+    char i;
+    for(i=0; i<QUEUE_SIZE; i++)
+    {
+        if(queue[i].used && queue[i].src == MACRO(n) + 1)
+            return TRUE;
+    }
+    return FALSE;
+}
 
-            if(morseCode & (BIT4 >> i))         // Check msg bits from BIT4 to BIT0
-                lineDelay;                      // Line Delay
+void runCommand()
+{
+    // inputMsg holds "!<command><args>". Main loop: the queue is shared
+    // with the WDT and beacon interrupts, so it is changed with them off.
+    char ok = TRUE, busy;
+    unsigned long waitSum;
+    char n = isdigit(inputMsg[2]) ? inputMsg[2] - '0' : MACRO_COUNT;   // Macro number, MACRO_COUNT if none
+    switch(tolower(inputMsg[1]))
+    {
+        case 's':
+            if(n >= MACRO_COUNT)
+            {
+                ok = FALSE;
+                break;
+            }
+            holdInput(TRUE);                    // The CPU stalls while flash is erased
+            _DINT();
+            busy = macroQueued(n);              // (a beacon can't queue it meanwhile)
+            if(!busy)
+                storeMacro(n, &inputMsg[3]);
+            _EINT();
+            holdInput(FALSE);
+            if(busy)
+                putString("\r\nMacro is queued, not stored");
+            break;
+        case 'l':
+            listMacros();
+            break;
+        case 'p':
+            _DINT();
+            busy = queueDepth >= QUEUE_SIZE - QUEUE_RESERVED;
+            if(!busy)
+                ok = startMacro(n, PRIO_NORMAL);
+            _EINT();
+            if(busy)
+                putString(queueFull);
+            break;
+        case 'u':
+            if(inputMsg[2] == 0)
+                ok = FALSE;
+            else if(enqueueText(&inputMsg[2], PRIO_URGENT) < 0)   // Alert: preempts at next letter
+                putString(queueFull);
+            break;
+        case 'q':
+            putString("\r\nQueue: ");
+            putNum(queueDepth);
+            putString(" waiting, max ");
+            putNum(queueMaxDepth);
+            putString(", played ");
+            putNum(statPlayed);
+            putString(", preempted ");
+            putNum(statPreempted);
+            putString(", wait avg ");
+            _DINT();
+            waitSum = statWaitSum;              // Not torn by the WDT
+            _EINT();
+            putNum(statStarted ? (waitSum * 16) / statStarted : 0);        // WDT ticks are ~16ms
+            putString("ms max ");
+            putNum(statWaitMax * 16UL);
+            putString("ms, rx overruns ");
+            putNum(rxOverruns);
+            break;
+        case 'b':
+            if(inputMsg[2] == 0)
+            {
+                beaconInterval = 0;             // Stop beacon
+                IE2 &= ~BTIE;
+            }
+            else if(n < MACRO_COUNT && parseNum(&inputMsg[3]) > 0)
+            {
+                beaconMacro = n;
+                beaconInterval = parseNum(&inputMsg[3]);
+                beaconCount = 0;
+                IE2 |= BTIE;                    // 1s Basic Timer ticks
+            }
             else
-                dotDelay;                       // Dot Delay
-            id=0;
-            P5OUT &= ~BIT1;                     // Led4 off
-            P3DIR &= ~BIT5;                     // Led4 off
-            // space between letter parts
-            dotDelay;
+                ok = FALSE;
+            break;
+        case 'm':
+            putString("\r\nStack peak: ");    // Deepest stack use since reset
+            putNum(stackHighWater());
+            putString(" of ");
+            putNum(STACK_END - STACK_START);
+            putString(" bytes");
+            break;
+        case 'f':
+            ok = padCommand(PAD_REG_FILTER, 1, 6);
+            break;
+        case 'd':
+            ok = padCommand(PAD_REG_SCAN_DELAY, 0, 255);   // x16 loops
+            break;
+        case 'c':
+            ok = padCommand(PAD_REG_CLAMP, 1, 255);        // Lower: lighter touch is a press
+            break;
+        case 'z':
+            ok = padCommand(PAD_REG_FLOOR, 0, 254);        // Higher: release sooner
+            break;
+        case 'r':
+            ok = padConfig(PAD_REG_RECAL, 0);               // Hands off the pad
+            break;
+        case 'i':
+            showPadStatus();                                // Refreshed every few hundred ms
+            break;
+        default:
+            ok = FALSE;
+            break;
+    }
+    if(ok == FALSE)
+        putString(cmdUsage);
+    memset(inputMsg, 0, sizeof(inputMsg));
+    _DINT();                                    // Else the WDT may end playback and prompt too
+    if(playSlot < 0 && queueDepth == 0)
+        putBytes(NLprompt,sizeof(NLprompt));
+    _EINT();
+}
 
-        }
-        send_DMA(&progress,sizeof(progress));   // Send Progress #
+void sendInput()
+{
+    // Queue the terminal message in inputMsg
+    if(inputMsg[0] == 0)
+    {
+        _DINT();
+        if(playSlot < 0 && queueDepth == 0)
+            putBytes(NLprompt,sizeof(NLprompt));    // Empty line: nothing to play
+        _EINT();
+        return;
+    }
+    if(enqueueText(inputMsg, PRIO_NORMAL) < 0)
+        putString(queueFull);
+    memset(inputMsg, 0, sizeof(inputMsg));
+}
+
+// Plays morse code on Buzzer, one step per WDT interval
+#pragma vector=WDT_VECTOR
+__interrupt void watchdog_timer(void)
+{
+    playClock++;
+    if(--playTicks > 0)
+        return;
 
-        // space between two letters
-        dotDelay;
-        dotDelay;
-        k++;
-        // clear current morse letter
-        morseCode=0;
+    switch(playPhase)
+    {
+        case PHASE_TONE:
+            buzzerOff();
+            playPhase = PHASE_GAP;      // space between letter parts
+            playTicks = PLAY_UNIT;
+            break;
+        case PHASE_GAP:
+            if(++playElement < morseSize(morseCode))
+            {
+                buzzerOn();
+                playPhase = PHASE_TONE;
+                playTicks = (morseElement(morseCode, playElement) == LINE) ? 3*PLAY_UNIT : PLAY_UNIT;
+            }
+            else
+            {
+                putBytes(&progress,sizeof(progress));   // Send Progress #
+                playPhase = PHASE_LETTER;   // space between two letters
+                playTicks = 2*PLAY_UNIT;
+            }
+            break;
+        case PHASE_LETTER:
+            if(playSlot >= 0 && queue[playSlot].next >= queue[playSlot].len)
+            {
+                queue[playSlot].used = FALSE;   // Message done
+                queueDepth--;
+                statPlayed++;
+                playSlot = -1;
+                inputPending = TRUE;        // Take a line held back by a full queue
+                LPM0_EXIT;
+            }
+            morseCode = 0;
+            nextLetter();
+            break;
     }
-    resetMorseBuzzer();                         // reset
 }
 
-void resetMorseBuzzer()
+// Beacon: queue a macro every beaconInterval seconds, asleep in between
+#pragma vector=BASICTIMER_VECTOR
+__interrupt void basic_timer(void)
 {
-    P5OUT &= ~BIT1;                     // STOP Buzzer
-    P3DIR &= ~BIT5;                     // clear Led4
-    morseCode=0;
-    isSending = FALSE;
-    char k=0;
-    // clear input message
-    while(inputMsg[k] != 0)
+    char i;
+    if(beaconInterval == 0 || ++beaconCount < beaconInterval)
+        return;
+    beaconCount = 0;
+    for(i=0; i<QUEUE_SIZE; i++)
     {
-        inputMsg[k] = 0;
-        k++;
+        if(queue[i].used && queue[i].prio == PRIO_BEACON)
+            return;                     // Previous beacon still waiting
     }
-    send_DMA(NLprompt,sizeof(NLprompt));
+    startMacro(beaconMacro, PRIO_BEACON);
+}
+
+void resetMorseBuzzer()
+{
+    buzzerOff();                        // STOP Buzzer
+    morseCode=0;
+    playSlot = -1;
+    putBytes(NLprompt,sizeof(NLprompt));
     WDTCTL = WDTPW | WDTHOLD;
 }
 
 #pragma vector = USCIAB0TX_VECTOR
 __interrupt void USCIAB0TX_ISR(void)
 {
+    if ((IE2 & UCA0TXIE) && (IFG2 & UCA0TXIFG)) // Terminal output, see putChar()
+    {
+        txNext();
+        return;                         // Back here for a pending I2C byte
+    }
+    padLinkState();
+    if (IFG2 & UCB0TXIFG)               // F2013 reads its configuration
+    {
+        UCB0TXBUF = padTxByte();
+        return;
+    }
+    if (padRxIndex > 0)                 // Status item after the pad level
+    {
+        uint8_t b = UCB0RXBUF;
+        if (padRxIndex < sizeof(padRx))
+            padRx[padRxIndex++] = b;
+        return;
+    }
+    padRxIndex++;
     xxx = UCB0RXBUF;                    // Get Value from MSP 2013 i2C
 
     //xxx = UCA0TXBUF = UCB0RXBUF;
-    if (xxx == 255)						// Capacitive Pad Pressed
+    // While a message plays the buzzer is the player's: new key presses are
+    // ignored, and a release only ends keying that started before playback.
+    if (xxx == 255 && playSlot < 0)		// Capacitive Pad Pressed
     {
+        if (keyDown == FALSE)
+        {
+            keyDown = TRUE;
+            lcdDirty = TRUE;            // Show live key-down on the LCD
+        }
         released = FALSE;
         P3DIR |= BIT5;					// Buzzer dir output (ON)
         P2OUT |= BIT2;					// LED2 ON
@@ -399,74 +1230,124 @@ __interrupt void USCIAB0TX_ISR(void)
     }
     else if (xxx == 0)					// Capacitive Pad Released
     {
+        if (keyDown == TRUE)
+        {
+            keyDown = FALSE;
+            lcdDirty = TRUE;
+        }
         released = TRUE;
-        P3DIR &= ~BIT5;					// Buzzer dir input (OFF)
+        if (playSlot < 0)
+            P3DIR &= ~BIT5;				// Buzzer dir input (OFF)
         P2OUT &=~BIT2;					// LED2 OFF
     }
+    if (lcdDirty)
+        LPM0_EXIT;                      // Only wake main loop to redraw
 }
 
-#pragma vector = USCIAB0RX_VECTOR
-__interrupt void USCIAB0RX_ISR(void)
+void handleChar(char c)
 {
-    if (IFG2&UCA0RXIFG && isSending == FALSE)           // If NOT SENDING and UCASCI Module
+    // Terminal line editing for one character taken from rxRing
+    putChar(c);                                     // echo char
+    if (isalnum(c) || c==8 || c==13 || (c=='!' && inPos==0))  // is it alpha or Number or Enter or Backspace, or a command
     {
-        char c = UCA0RXBUF;                             // get char
-        IFG2 &=~UCA0RXIFG;                              // CLEAR UCA0RXIFG
-        while(!(IFG2&UCA0TXIFG));                       // wait for TX to be free
-        UCA0TXBUF = c;                                  // echo char
-        if (isalnum(c) || c==8 || c==13)                // is it alpha or Number or Enter or Backspace
+        if(inPos < maxCharacters-1)
         {
-            if(pos < maxCharacters-1)
+            if(c==8)                                // backspace handling
+            {
+                if(inPos >0)
+                {
+                    inPos--;
+                    inputMsg[inPos] = 0;
+                    putChar(' ');                   // Sprint Space
+                    putChar(8);                     // Print backSpace
+                }
+                else                                // Don't delete other chars other than the one inserted
+                {
+                    putChar(' ');                   // TXBUF <= RXBUF (echo)
+                }
+            }
+            else
             {
-                if(c==8)                                // backspace handling
+                if(c != 13)							// if not Carrage Return
+                {
+                    inputMsg[inPos] = c;            // Store Char in inputMsg array
+                    inPos++;
+                }
+                else if (inputMsg[0] == '!')        // ENTER after a macro command
                 {
-                    if(pos >0)
-                    {
-                        pos--;
-                        inputMsg[pos] = 0;
-                        while(!(IFG2&UCA0TXIFG));       // Wait until TXBUF is free
-                        UCA0TXBUF = ' ';                // Sprint Space
-                        while(!(IFG2&UCA0TXIFG));       // Wait until TXBUF is free
-                        UCA0TXBUF = 8;                  // Print backSpace
-                    }
-                    else                                // Don't delete other chars other than the one inserted
-                    {
-                        while(!(IFG2&UCA0TXIFG));       // Wait until TXBUF is free
-                        UCA0TXBUF = ' ';                // TXBUF <= RXBUF (echo)
-                    }
+                    inPos=0;
+                    runCommand();
                 }
-                else
+                else                                // carriage return (ENTER))
                 {
-                    if(c != 13)							// if not Carrage Return
-                    {
-                        inputMsg[pos] = c;              // Store Char in inputMsg array
-                        pos++;
-                    }
-                    else                                // carriage return (ENTER))
-                    {
-                        pos=0;
-                        isSending = TRUE;               // Don't allow insertion through terminal
-                        playMorseCode();                // Play Morse Code WDtimer
-
-                    }
+                    inPos=0;
+                    sendInput();                    // Queue for the Buzzer
                 }
             }
-            else                                        
-            {// HANDLE OVERFLOW Maximum chars inserted, send to Morse
-                pos=0;
-                isSending = TRUE;
-                send_DMA(newLine,sizeof(newLine));
-                playMorseCode();
+        }
+        else                                        
+        {// HANDLE OVERFLOW Maximum chars inserted, send to Morse
+            inPos=0;
+            if (inputMsg[0] == '!')
+            {
+                runCommand();
+            }
+            else
+            {
+                putBytes(newLine,sizeof(newLine));
+                sendInput();
             }
         }
-        else
+    }
+    else
+    {
+        putBytes(specChar,sizeof(specChar));        // Error message if char not in MorseCode
+        putBytes(NLprompt,sizeof(NLprompt));
+    }
+}
+
+void processInput()
+{
+    // Main loop: take what the RX interrupt left in rxRing
+    while(rxCount > 0 && isSending == FALSE)        // If NOT SENDING
+    {
+        char c = rxRing[rxTail];
+        if(endsLine(c) && queueDepth >= QUEUE_SIZE - QUEUE_RESERVED)
+            break;                                  // Wait for a free queue slot
+        _DINT();
+        rxTail = (rxTail + 1) % RX_SIZE;
+        rxCount--;
+        flowControl();                              // XON once the ring has drained
+        _EINT();
+        handleChar(c);
+    }
+}
+
+#pragma vector = USCIAB0RX_VECTOR
+__interrupt void USCIAB0RX_ISR(void)
+{
+    if (IFG2&UCA0RXIFG)                                 // UCASCI Module
+    {
+        char overrun = UCA0STAT & UCOE;                 // Lost in the UART, before this one
+        char c = UCA0RXBUF;                             // get char, clears UCA0RXIFG and UCOE
+        if(overrun)
+            rxOverruns++;
+        if(rxCount < RX_SIZE)
         {
-            send_DMA(specChar,sizeof(specChar));        // Error message if char not in MorseCode
+            rxRing[rxHead] = c;
+            rxHead = (rxHead + 1) % RX_SIZE;
+            rxCount++;
         }
+        else
+            rxOverruns++;
+        flowControl();
+        inputPending = TRUE;                            // Echo and editing run in the main loop
+        LPM0_EXIT;
     }
 
-    UCB0STAT &= ~(UCSTPIFG | UCSTTIFG);
-    LPM0_EXIT;
+    padLinkState();
+    if (lcdDirty)
+        LPM0_EXIT;
 }
 
 void startTimerA()							// Check Capacitive Pad State every 0.1 sec using Interrupt
@@ -491,16 +1372,15 @@ __interrupt void TA0_ISR(void)
     isSending = TRUE;
     if (released == TRUE)                       // capacitive button
     {
-        if(k>0 && k <=4 )                       // 0-0.5 sec
-        {
-            touchMsg[pos]= DOT;
-            TACCTL0 &= ~CCIE;                   // CLEAR interrupt ENABLED
-            k=0;
-            pos++;
-        }
-        if(k>=5)                                // 0.6 sec and up
+        char element = morseKeyed(k);           // DOT up to 0.4 sec, LINE above
+        if(element != 0)
         {
-            touchMsg[pos] = LINE;
+            if(element == DOT && dotAvg == 0)
+                dotAvg = k << 4;                // First DOT seeds the average
+            else if(element == DOT)
+                dotAvg += ((k << 4) - dotAvg) >> 2;  // Running average for WPM
+            lcdDirty = TRUE;
+            touchMsg[pos] = element;
             TACCTL0 &= ~CCIE;                   // CLEAR interrupt ENABLED
             k=0;
             pos++;
@@ -515,11 +1395,21 @@ __interrupt void TA0_ISR(void)
     }
 
     k++;
+    if (lcdDirty)
+        LPM0_EXIT;
 }
 
 #pragma vector = PORT1_VECTOR
 __interrupt void Port1_ISR (void)
 {
+    // SW1+SW2 chord: play macro 0
+    if(!(SW1) && !(SW2) && isSending == FALSE && INCOMING_STATE == FALSE)
+    {
+        P1IFG &= ~(BIT1+BIT0);
+        startMacro(0, PRIO_NORMAL);
+        return;
+    }
+
     // End of Character
     if((P1IFG & BIT1) && pos>0 && pos <5)           // SW2 Pressed
     {
@@ -533,22 +1423,11 @@ __interrupt void Port1_ISR (void)
     {
         isSending = FALSE;
         INCOMING_STATE=FALSE;
-        send_DMA(NLprompt,sizeof(NLprompt));
+        putBytes(NLprompt,sizeof(NLprompt));
+        inputPending = TRUE;                        // Characters typed meanwhile
     }
 
     P1IFG &= ~(BIT1+BIT0);             				// clear IFG SW1 & SW2
+    if (lcdDirty || inputPending)
+        LPM0_EXIT;
 }
-
-// Interrupt for DMA
-#pragma vector=DMA_VECTOR
-__interrupt void DMA_ISR (void)
-{
-    int static ii = 0;
-    DMAIV &= ~DMAIV_DMA0IFG;            			// clear DMA IFG flag
-    if(ii==0)                           			// SEND Prompt Text after TITLE
-        send_DMA(prompt,sizeof(prompt));
-
-    if(DMA0SA == specChar)              			// print after non morse char
-        send_DMA(NLprompt,sizeof(NLprompt));
-    ii++;
-}
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*------------------------------------------------------------------------------
+ * Function:    Morse Code Communication Platform (shared definitions)
+ * Description: Morse Code table and terminal messages used by 4618_code.c.
+ *              MC_chars[i] is sent as MC_code[i], a string of DOT and LINE
+ *              elements; MC_code_size[i] is its length including the NULL
+ *              END char, as expected by morseEncode().
+ *              Only plain C here: the host tools in host/ include this file
+ *              as well.
+ * Author:		David Tougaw
+ *------------------------------------------------------------------------------*/
+#ifndef DEFINITIONS_H
+#define DEFINITIONS_H
+
+#define DOT  '.'
+#define LINE '_'
+
+#define MC_COUNT 36
+
+const char MC_chars[MC_COUNT] =
+{
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+    'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9'
+};
+
+const char * const MC_code[MC_COUNT] =
+{
+    "._",       // a
+    "_...",     // b
+    "_._.",     // c
+    "_..",      // d
+    ".",        // e
+    ".._.",     // f
+    "__.",      // g
+    "....",     // h
+    "..",       // i
+    ".___",     // j
+    "_._",      // k
+    "._..",     // l
+    "__",       // m
+    "_.",       // n
+    "___",      // o
+    ".__.",     // p
+    "__._",     // q
+    "._.",      // r
+    "...",      // s
+    "_",        // t
+    ".._",      // u
+    "..._",     // v
+    ".__",      // w
+    "_.._",     // x
+    "_.__",     // y
+    "__..",     // z
+    "_____",    // 0
+    ".____",    // 1
+    "..___",    // 2
+    "...__",    // 3
+    "...._",    // 4
+    ".....",    // 5
+    "_....",    // 6
+    "__...",    // 7
+    "___..",    // 8
+    "____."     // 9
+};
+
+const char MC_code_size[MC_COUNT] =
+{
+    3, 5, 5, 4, 2, 5, 4, 5, 3, 5, 4, 5, 3,
+    3, 4, 5, 5, 4, 4, 2, 4, 5, 4, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6
+};
+
+// Terminal messages. putBytes() sends them with their NULL END char.
+const char title0[] =
+    "\r\n"
+    "    __  ___                        ______          __\r\n"
+    "   /  |/  /___  _____________     / ____/___  ____/ /__\r\n"
+    "  / /|_/ / __ \\/ ___/ ___/ _ \\   / /   / __ \\/ __  / _ \\\r\n"
+    " / /  / / /_/ / /  (__  )  __/  / /___/ /_/ / /_/ /  __/\r\n"
+    "/_/  /_/\\____/_/  /____/\\___/   \\____/\\____/\\__,_/\\___/\r\n"
+    "\r\n";
+const char prompt[] = "Insert Text To Send: ";
+const char NLprompt[] = "\r\nInsert Text To Send: ";
+const char newLine[] = "\r\n";
+const char sending[] = "Sending Morse Code...";
+const char progress = '#';
+const char specChar[] = "\r\nCharacter not present in Morse Code\r\n";
+const char incomingChar[] = "\r\nIncoming Char:";
+
+void timerASetUp(void);
+void startTimerA(void);
+void resetMorseBuzzer(void);
+void processInput(void);
+void flowControl(void);
+
+#endif
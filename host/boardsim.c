@@ -0,0 +1,373 @@
+/*------------------------------------------------------------------------------
+ * Function:    Morse Code Communication Platform (simulated boards)
+ * Description: Creates N pseudo-terminals that behave like the RS232 side of
+ *              4618_code.c: title and prompt at start up, character echo,
+ *              "Sending Morse Code..." followed by one "#" per played
+ *              character, the prompt again when playback is done, and
+ *              "Character not present in Morse Code" for rejected input.
+ *              As on the board, the terminal stays live while a message
+ *              plays: lines are queued (QUEUE_SIZE), ENTER is held back
+ *              while the queue is full, and the input ring sends XOFF/XON
+ *              at RX_HIGH/RX_LOW, so the gateway's flow control is
+ *              exercised too. The prompt comes back when the queue is
+ *              empty.
+ *              Optionally each board also runs touch pad sessions whenever
+ *              it is not playing, also with a gateway line in flight: the
+ *              terminal is held for about five elements (typed input, ENTER
+ *              included, waits in the ring), then "Incoming Char:x" and the
+ *              prompt follow as when SW1 is pressed.
+ *
+ *              The slave device names are printed one per line on stdout, so
+ *              they can be handed straight to the gateway:
+ *                  boardsim -n 128 > ports &  gateway $(cat ports)
+ *
+ * Input:       Pseudo-terminal masters
+ * Output:      Pseudo-terminal masters, stdout (slave names)
+ * Usage:       boardsim [-n boards] [-c ms per char] [-i ms between incoming chars]
+ *------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <sys/epoll.h>
+
+#define FALSE 0
+#define TRUE (!FALSE)
+
+#define maxCharacters 25
+#define QUEUE_SIZE    6
+#define RX_SIZE       32
+#define RX_HIGH       16
+#define RX_LOW        4
+
+#define XON           0x11
+#define XOFF          0x13
+
+static const char title0[] = "\r\n  Morse Code\r\n\r\n";
+static const char prompt[] = "Insert Text To Send: ";
+static const char NLprompt[] = "\r\nInsert Text To Send: ";
+static const char newLine[] = "\r\n";
+static const char sending[] = "Sending Morse Code...";
+static const char specChar[] = "\r\nCharacter not present in Morse Code\r\n";
+static const char incomingChar[] = "\r\nIncoming Char:";
+
+struct sim_board
+{
+    int master;
+    int slave;                                  /* Held open so the master never sees EIO */
+    char inputMsg[maxCharacters];
+    int pos;
+
+    /* Playback queue, played in order (no urgent messages from the gateway) */
+    char queue[QUEUE_SIZE][maxCharacters];
+    int q_head, q_count;
+    int isSending;
+    int keying;                                 /* Touch pad session: input is held */
+    int played;                                 /* Characters of queue[q_head] played so far */
+
+    /* Input ring and XON/XOFF, as in the firmware's FLOW CONTROL */
+    char ring[RX_SIZE];
+    int r_head, r_count;
+    int stopped;
+    int paused;                                 /* Ring full, master not polled */
+
+    long long next_ms;                          /* Next playback or incoming event */
+};
+
+static volatile sig_atomic_t quit;
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void put(struct sim_board *b, const char *s, int len)
+{
+    /* Like putBytes() the terminator goes out as well */
+    if (write(b->master, s, len) < 0 && errno != EAGAIN)
+        perror("write");
+}
+
+static void start_next(struct sim_board *b, int char_ms)
+{
+    /* nextLetter() picking a new message */
+    b->isSending = TRUE;
+    b->played = 0;
+    put(b, sending, sizeof(sending));
+    b->next_ms = now_ms() + char_ms;
+}
+
+static void send_input(struct sim_board *b, int char_ms)
+{
+    /* sendInput(): queue the line, start playback if idle */
+    b->inputMsg[b->pos] = 0;
+    b->pos = 0;
+    if (b->inputMsg[0] == 0)
+    {
+        if (!b->isSending)
+            put(b, NLprompt, sizeof(NLprompt));
+        return;
+    }
+    memcpy(b->queue[(b->q_head + b->q_count) % QUEUE_SIZE], b->inputMsg, maxCharacters);
+    b->q_count++;
+    memset(b->inputMsg, 0, sizeof(b->inputMsg));
+    if (!b->isSending)
+        start_next(b, char_ms);
+}
+
+static void handle_char(struct sim_board *b, char c, int char_ms)
+{
+    /* handleChar() */
+    put(b, &c, 1);
+    if (isalnum((unsigned char)c) || c == 8 || c == 13)
+    {
+        if (b->pos < maxCharacters - 1 && c != 13)
+        {
+            if (c == 8)
+            {
+                if (b->pos > 0)
+                    b->inputMsg[--b->pos] = 0;
+            }
+            else
+            {
+                b->inputMsg[b->pos++] = c;
+            }
+        }
+        else
+        {
+            if (c != 13)
+                put(b, newLine, sizeof(newLine));
+            send_input(b, char_ms);
+        }
+    }
+    else
+    {
+        put(b, specChar, sizeof(specChar));
+        put(b, NLprompt, sizeof(NLprompt));
+    }
+}
+
+static int ends_line(struct sim_board *b, char c)
+{
+    return c == 13 || (b->pos >= maxCharacters - 1 && (isalnum((unsigned char)c) || c == 8));
+}
+
+static void process_input(struct sim_board *b, int char_ms)
+{
+    /* processInput(): ENTER waits for a free queue slot */
+    while (b->r_count > 0 && !b->keying)
+    {
+        char c = b->ring[(b->r_head + RX_SIZE - b->r_count) % RX_SIZE];
+
+        if (ends_line(b, c) && b->q_count >= QUEUE_SIZE)
+            break;
+        b->r_count--;
+        handle_char(b, c, char_ms);
+    }
+    if (!b->stopped && b->r_count >= RX_HIGH)
+    {
+        char x = XOFF;
+
+        b->stopped = TRUE;
+        put(b, &x, 1);
+    }
+    else if (b->stopped && b->r_count <= RX_LOW)
+    {
+        char x = XON;
+
+        b->stopped = FALSE;
+        put(b, &x, 1);
+    }
+}
+
+static void rx_char(struct sim_board *b, char c, int char_ms)
+{
+    /* USCIAB0RX_ISR. The caller only reads what fits in the ring. */
+    b->ring[b->r_head] = c;
+    b->r_head = (b->r_head + 1) % RX_SIZE;
+    b->r_count++;
+    process_input(b, char_ms);
+}
+
+static void poll_master(int epfd, struct sim_board *b, int idx, int on)
+{
+    /* A pty buffers everything a host writes before our XOFF reaches it,
+       where a real line stops within a character or two. So rather than
+       model overruns, stop reading while the ring is full. */
+    struct epoll_event ev;
+
+    b->paused = !on;
+    ev.events = on ? EPOLLIN : 0;
+    ev.data.u32 = idx;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, b->master, &ev);
+}
+
+static void tick(struct sim_board *b, long long now, int char_ms, int incoming_ms)
+{
+    /* watchdog_timer: one "#" per character, the next message, or the
+       prompt once the queue is empty */
+    if (b->isSending)
+    {
+        if (b->queue[b->q_head][b->played])
+        {
+            put(b, "#", 1);
+            b->played++;
+            b->next_ms = now + char_ms;
+            return;
+        }
+        b->q_head = (b->q_head + 1) % QUEUE_SIZE;
+        b->q_count--;
+        if (b->q_count > 0)
+        {
+            start_next(b, char_ms);
+        }
+        else
+        {
+            b->isSending = FALSE;
+            put(b, NLprompt, sizeof(NLprompt));
+        }
+        process_input(b, char_ms);              /* A line held back by a full queue */
+        if (b->isSending)
+            return;
+    }
+    else if (incoming_ms > 0 && !b->keying)
+    {
+        /* The operator starts keying (the pad is ignored during playback).
+           Like isSending on the board this holds the terminal, so a line
+           typed meanwhile, even its ENTER, waits in the ring. */
+        b->keying = TRUE;
+        b->next_ms = now + 5*char_ms;           /* Five elements or so */
+        return;
+    }
+    else if (b->keying)
+    {
+        char c = 'a' + rand() % 26;
+
+        /* A one character touch pad session ended with SW1 */
+        put(b, incomingChar, sizeof(incomingChar));
+        put(b, &c, 1);
+        put(b, NLprompt, sizeof(NLprompt));
+        b->keying = FALSE;
+        process_input(b, char_ms);              /* Characters typed meanwhile */
+        if (b->isSending)
+            return;
+    }
+    b->next_ms = incoming_ms > 0 ? now + incoming_ms : 0;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    quit = TRUE;
+}
+
+int main(int argc, char **argv)
+{
+    struct sim_board *boards;
+    struct epoll_event ev, events[64];
+    int nboards = 1, char_ms = 20, incoming_ms = 0;
+    int epfd, opt, i;
+
+    while ((opt = getopt(argc, argv, "n:c:i:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': nboards = atoi(optarg); break;
+        case 'c': char_ms = atoi(optarg); break;
+        case 'i': incoming_ms = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: boardsim [-n boards] [-c ms per char] [-i ms between incoming chars]\n");
+            return 2;
+        }
+    }
+    if (nboards <= 0)
+        return 2;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    epfd = epoll_create1(0);
+    boards = calloc(nboards, sizeof(*boards));
+    if (epfd < 0 || !boards)
+    {
+        perror("boardsim");
+        return 1;
+    }
+    for (i = 0;  i < nboards;  i++)
+    {
+        struct sim_board *b = &boards[i];
+        struct termios tio;
+
+        b->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (b->master < 0 || grantpt(b->master) || unlockpt(b->master))
+        {
+            perror("posix_openpt");
+            return 1;
+        }
+        b->slave = open(ptsname(b->master), O_RDWR | O_NOCTTY);
+        if (b->slave < 0 || tcgetattr(b->slave, &tio))
+        {
+            perror(ptsname(b->master));
+            return 1;
+        }
+        cfmakeraw(&tio);
+        tcsetattr(b->slave, TCSANOW, &tio);
+        printf("%s\n", ptsname(b->master));
+
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, b->master, &ev);
+
+        /* sendTitle() and the prompt, as in main() */
+        put(b, title0, sizeof(title0));
+        put(b, prompt, sizeof(prompt));
+        b->next_ms = incoming_ms > 0 ? now_ms() + rand() % incoming_ms : 0;
+    }
+    fflush(stdout);
+
+    while (!quit)
+    {
+        long long now = now_ms(), next = 0;
+        int timeout, n;
+
+        for (i = 0;  i < nboards;  i++)
+        {
+            if (boards[i].next_ms && boards[i].next_ms <= now)
+                tick(&boards[i], now, char_ms, incoming_ms);
+            if (boards[i].paused && boards[i].r_count < RX_SIZE)
+                poll_master(epfd, &boards[i], i, TRUE);
+            if (boards[i].next_ms && (next == 0 || boards[i].next_ms < next))
+                next = boards[i].next_ms;
+        }
+        timeout = next ? (int)(next - now) : 500;
+        if (timeout < 0)
+            timeout = 0;
+
+        n = epoll_wait(epfd, events, 64, timeout);
+        for (i = 0;  i < n;  i++)
+        {
+            int idx = events[i].data.u32;
+            struct sim_board *b = &boards[idx];
+            char buf[RX_SIZE];
+            ssize_t len, k;
+
+            while (b->r_count < RX_SIZE && (len = read(b->master, buf, RX_SIZE - b->r_count)) > 0)
+            {
+                for (k = 0;  k < len;  k++)
+                    rx_char(b, buf[k], char_ms);
+            }
+            if (b->r_count == RX_SIZE)
+                poll_master(epfd, b, idx, FALSE);
+        }
+    }
+    return 0;
+}
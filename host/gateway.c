@@ -0,0 +1,827 @@
+/*------------------------------------------------------------------------------
+ * Function:    Morse Code Communication Platform (Linux gateway daemon)
+ * Description: Multiplexes the RS232 links of many MSP430FG4618 boards in one
+ *              epoll event loop. The loop thread only moves bytes: board
+ *              output is handed to a pool of worker threads that parse the
+ *              terminal stream ("Insert Text To Send:", "Sending Morse
+ *              Code...", "#" progress marks, "Incoming Char:x") and keep
+ *              track of each board's playback state. Outbound text is queued
+ *              per board and typed into a board one line at a time, while it
+ *              sits at its prompt. The firmware would queue more lines itself,
+ *              but its prompt only comes back once its own queue is empty, so
+ *              typing one line per prompt is what ties each DONE to its
+ *              message. The board's XON/XOFF paces the typing (IXON).
+ *
+ *              Clients talk to the daemon over a local (AF_UNIX) socket with
+ *              a line protocol:
+ *                  LIST                 list boards and their state
+ *                  SEND <board> <text>  queue text, replies "OK <msgid>"
+ *                                       ("ERR board" once its port hung up)
+ *                  STATS                aggregate counters
+ *                  SUB                  receive events on this connection:
+ *                                       RX <board> <char>
+ *                                       DONE <board> <msgid> <latency ms>
+ *                                       REJECT <board>
+ *
+ * Input:       Serial ports / pseudo-terminals, local socket
+ * Output:      Serial ports / pseudo-terminals, local socket
+ * Usage:       gateway [-s socket] [-w workers] port...
+ *------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define FALSE 0
+#define TRUE (!FALSE)
+
+/* Terminal messages of 4618_code.c (see definitions.h) */
+#define MSG_PROMPT          "Insert Text To Send: "
+#define MSG_SENDING         "Sending Morse Code..."
+#define MSG_INCOMING        "Incoming Char:"
+#define MSG_SPECCHAR        "Character not present in Morse Code"
+#define MSG_PROGRESS        '#'
+
+#define maxCharacters       25                  /* inputMsg[] size on the board */
+#define maxLine             (maxCharacters-2)   /* Chars typed before ENTER */
+
+#define DEFAULT_SOCKET      "/tmp/morse-gateway.sock"
+#define DEFAULT_WORKERS     4
+#define MAX_EVENTS          64
+#define RX_CHUNK            256
+#define TAIL_SIZE           48                  /* Longer than any message */
+#define CLIENT_LINE         512
+#define CLIENT_OUT          16384               /* Events waiting for a slow subscriber */
+
+enum board_state
+{
+    BOARD_UNKNOWN = 0,                          /* No prompt seen yet */
+    BOARD_READY,                                /* Sitting at "Insert Text To Send:" */
+    BOARD_TYPING,                               /* We are typing a line into it */
+    BOARD_SENDING,                              /* Playing a message on the buzzer */
+    BOARD_INCOMING                              /* Operator keying on the touch pad */
+};
+
+static const char *state_name[] =
+{
+    "unknown", "ready", "typing", "sending", "incoming"
+};
+
+struct message
+{
+    struct message *next;
+    unsigned long id;
+    struct timespec queued;
+    int len;
+    char text[maxLine + 1];
+};
+
+struct board
+{
+    int idx;
+    int fd;
+    const char *path;
+    pthread_mutex_t lock;
+
+    /* Filled by the event loop, drained by a worker */
+    char rx[RX_CHUNK * 4];
+    int rx_len;
+    int scheduled;
+
+    /* Parser */
+    char tail[TAIL_SIZE];
+    int tail_len;
+    int expect_char;
+    enum board_state state;
+
+    /* Outbound */
+    struct message *head, *last;
+    struct message *current;
+    int queued;
+    char tx[maxLine + 2];
+    int tx_len, tx_off;
+
+    /* Counters */
+    unsigned long sent, received, progress, rejected;
+
+    int dead;                                   /* Port hung up, fd closed */
+};
+
+struct client
+{
+    int fd;
+    int subscribed;
+    char line[CLIENT_LINE];
+    int len;
+    char out[CLIENT_OUT];                       /* Unsent output, whole lines */
+    int out_len;
+    struct client *next;
+};
+
+static struct board *boards;
+static int nboards;
+static int epfd;
+static int listen_fd;
+static volatile sig_atomic_t quit;
+
+static struct client *clients;
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Boards with unparsed input. Each board is queued at most once. */
+static struct board **jobs;
+static int job_head, job_count;
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_mutex_t id_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long next_id = 1;
+
+/* epoll user data: boards are tagged by index, others by pointer */
+#define TAG_LISTEN      ((uint64_t)1 << 62)
+#define TAG_CLIENT      ((uint64_t)1 << 63)
+
+static void die(const char *what)
+{
+    perror(what);
+    exit(1);
+}
+
+static long elapsed_ms(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/* ------------------------------- CLIENTS ------------------------------- */
+
+static void client_arm(struct client *c, int on)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+    ev.data.u64 = TAG_CLIENT | (uintptr_t)c;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static int client_flush(struct client *c)
+{
+    /* Caller holds clients_lock. Returns FALSE if output is still pending. */
+    int off = 0;
+
+    while (off < c->out_len)
+    {
+        ssize_t n = write(c->fd, c->out + off, c->out_len - off);
+        if (n <= 0)
+            break;
+        off += n;
+    }
+    c->out_len -= off;
+    memmove(c->out, c->out + off, c->out_len);
+    return c->out_len == 0;
+}
+
+static void client_write(struct client *c, const char *buf, int len)
+{
+    /* Caller holds clients_lock, buf holds whole lines. What the socket does
+       not take right away waits in c->out; a client that cannot keep up loses
+       whole lines rather than stall the gateway or get torn ones. */
+    int was_empty = (c->out_len == 0);
+
+    if (c->out_len + len > (int)sizeof(c->out))
+        return;
+    memcpy(c->out + c->out_len, buf, len);
+    c->out_len += len;
+    if (was_empty && !client_flush(c))
+        client_arm(c, TRUE);
+}
+
+static void client_writable(struct client *c)
+{
+    pthread_mutex_lock(&clients_lock);
+    if (client_flush(c))
+        client_arm(c, FALSE);
+    pthread_mutex_unlock(&clients_lock);
+}
+
+static void client_printf(struct client *c, const char *fmt, ...)
+{
+    char buf[CLIENT_LINE];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len > (int)sizeof(buf) - 1)
+        len = sizeof(buf) - 1;
+    pthread_mutex_lock(&clients_lock);          /* Don't interleave with broadcast() */
+    client_write(c, buf, len);
+    pthread_mutex_unlock(&clients_lock);
+}
+
+static void broadcast(const char *buf, int len)
+{
+    struct client *c;
+
+    pthread_mutex_lock(&clients_lock);
+    for (c = clients;  c;  c = c->next)
+    {
+        if (c->subscribed)
+            client_write(c, buf, len);
+    }
+    pthread_mutex_unlock(&clients_lock);
+}
+
+/* -------------------------------- BOARDS -------------------------------- */
+
+static int open_port(const char *path)
+{
+    struct termios tio;
+    int fd;
+
+    fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        return -1;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        /* 115200 bps, 8 bits, no parity, as configured in configure_uart_usci0() */
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_iflag |= IXON;                    /* Board paces us with XON/XOFF */
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static void schedule(struct board *b)
+{
+    /* Caller holds b->lock */
+    if (b->scheduled)
+        return;
+    b->scheduled = TRUE;
+    pthread_mutex_lock(&jobs_lock);
+    jobs[(job_head + job_count) % nboards] = b;
+    job_count++;
+    pthread_cond_signal(&jobs_cond);
+    pthread_mutex_unlock(&jobs_lock);
+}
+
+static void arm_output(struct board *b, int on)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+    ev.data.u64 = b->idx;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, b->fd, &ev);
+}
+
+static void flush_tx(struct board *b)
+{
+    /* Caller holds b->lock */
+    if (b->dead)
+        return;
+    while (b->tx_off < b->tx_len)
+    {
+        ssize_t n = write(b->fd, b->tx + b->tx_off, b->tx_len - b->tx_off);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EAGAIN)
+                arm_output(b, TRUE);
+            return;
+        }
+        b->tx_off += n;
+    }
+    b->tx_len = b->tx_off = 0;
+}
+
+static void dispatch(struct board *b)
+{
+    /* Caller holds b->lock. Type the next queued line while the board is idle. */
+    struct message *m;
+
+    if (b->dead || b->state != BOARD_READY || b->current || !b->head)
+        return;
+    m = b->head;
+    b->head = m->next;
+    if (!b->head)
+        b->last = NULL;
+    b->queued--;
+    b->current = m;
+    memcpy(b->tx, m->text, m->len);
+    b->tx[m->len] = '\r';                       /* ENTER starts playMorseCode() */
+    b->tx_len = m->len + 1;
+    b->tx_off = 0;
+    b->state = BOARD_TYPING;
+    flush_tx(b);
+}
+
+static int tail_ends_with(struct board *b, const char *s)
+{
+    int n = strlen(s);
+
+    return b->tail_len >= n && memcmp(b->tail + b->tail_len - n, s, n) == 0;
+}
+
+static int parse(struct board *b, const char *buf, int len, char *ev, int evsize)
+{
+    /* Caller holds b->lock. Returns the length of the event text written to ev. */
+    int evlen = 0;
+    int i;
+
+    for (i = 0;  i < len;  i++)
+    {
+        char c = buf[i];
+
+        if (c == 0)                             /* putBytes() also sends the terminator */
+            continue;
+        if (b->expect_char)
+        {
+            b->expect_char = FALSE;
+            b->received++;
+            if (evlen < evsize - 32)
+                evlen += sprintf(ev + evlen, "RX %d %c\n", b->idx, c);
+            continue;
+        }
+        if (c == MSG_PROGRESS && b->state == BOARD_SENDING)
+        {
+            b->progress++;
+            continue;
+        }
+        if (b->tail_len == TAIL_SIZE)
+        {
+            memmove(b->tail, b->tail + TAIL_SIZE/2, TAIL_SIZE/2);
+            b->tail_len = TAIL_SIZE/2;
+        }
+        b->tail[b->tail_len++] = c;
+
+        if (tail_ends_with(b, MSG_PROMPT))
+        {
+            /* The board also prompts after a touch pad session and after
+               MSG_SPECCHAR; only a prompt after MSG_SENDING ends a message */
+            if (b->current && b->state != BOARD_SENDING)
+            {
+                b->tail_len = 0;
+                continue;                       /* Our line is still in flight */
+            }
+            if (b->current)
+            {
+                /* Back at the prompt: the message has been played */
+                b->sent++;
+                if (evlen < evsize - 64)
+                    evlen += sprintf(ev + evlen, "DONE %d %lu %ld\n", b->idx,
+                                     b->current->id, elapsed_ms(&b->current->queued));
+                free(b->current);
+                b->current = NULL;
+            }
+            b->state = BOARD_READY;
+            b->tail_len = 0;
+        }
+        else if (tail_ends_with(b, MSG_SENDING))
+        {
+            b->state = BOARD_SENDING;
+            b->tail_len = 0;
+        }
+        else if (tail_ends_with(b, MSG_INCOMING))
+        {
+            if (b->state != BOARD_TYPING && b->state != BOARD_SENDING)
+                b->state = BOARD_INCOMING;
+            b->expect_char = TRUE;
+            b->tail_len = 0;
+        }
+        else if (tail_ends_with(b, MSG_SPECCHAR))
+        {
+            b->rejected++;
+            if (evlen < evsize - 32)
+                evlen += sprintf(ev + evlen, "REJECT %d\n", b->idx);
+            b->tail_len = 0;
+        }
+    }
+    return evlen;
+}
+
+static void *worker(void *arg)
+{
+    char buf[sizeof(((struct board *)0)->rx)];
+    char ev[2048];
+
+    (void)arg;
+    for (;;)
+    {
+        struct board *b;
+        int len, evlen;
+
+        pthread_mutex_lock(&jobs_lock);
+        while (job_count == 0 && !quit)
+            pthread_cond_wait(&jobs_cond, &jobs_lock);
+        if (quit)
+        {
+            pthread_mutex_unlock(&jobs_lock);
+            return NULL;
+        }
+        b = jobs[job_head];
+        job_head = (job_head + 1) % nboards;
+        job_count--;
+        pthread_mutex_unlock(&jobs_lock);
+
+        pthread_mutex_lock(&b->lock);
+        len = b->rx_len;
+        memcpy(buf, b->rx, len);
+        b->rx_len = 0;
+        evlen = parse(b, buf, len, ev, sizeof(ev));
+        dispatch(b);
+        b->scheduled = FALSE;
+        pthread_mutex_unlock(&b->lock);
+
+        if (evlen)
+            broadcast(ev, evlen);
+    }
+}
+
+static void board_readable(struct board *b)
+{
+    char buf[RX_CHUNK];
+    ssize_t n;
+
+    if (b->dead)
+        return;
+    while ((n = read(b->fd, buf, sizeof(buf))) > 0)
+    {
+        pthread_mutex_lock(&b->lock);
+        if (b->rx_len + n > (int)sizeof(b->rx))
+            n = sizeof(b->rx) - b->rx_len;      /* Worker is far behind: drop */
+        memcpy(b->rx + b->rx_len, buf, n);
+        b->rx_len += n;
+        schedule(b);
+        pthread_mutex_unlock(&b->lock);
+    }
+    if (n == 0 || (n < 0 && errno != EAGAIN))
+    {
+        /* Port gone (cable pulled, simulator closed): close it and drop
+           what was queued for it, SEND is refused from now on */
+        struct message *m;
+
+        fprintf(stderr, "gateway: board %d (%s) hung up\n", b->idx, b->path);
+        pthread_mutex_lock(&b->lock);
+        epoll_ctl(epfd, EPOLL_CTL_DEL, b->fd, NULL);
+        close(b->fd);
+        b->fd = -1;
+        b->dead = TRUE;
+        while ((m = b->head) != NULL)
+        {
+            b->head = m->next;
+            free(m);
+        }
+        b->last = NULL;
+        b->queued = 0;
+        free(b->current);
+        b->current = NULL;
+        b->tx_len = b->tx_off = 0;
+        pthread_mutex_unlock(&b->lock);
+    }
+}
+
+static void board_writable(struct board *b)
+{
+    pthread_mutex_lock(&b->lock);
+    flush_tx(b);
+    if (b->tx_len == 0)
+        arm_output(b, FALSE);
+    pthread_mutex_unlock(&b->lock);
+}
+
+static unsigned long enqueue(struct board *b, const char *text)
+{
+    /* Only characters the firmware accepts are sent. Long text is split into
+       lines that fit inputMsg[], each one a separate message. */
+    struct message *m = NULL;
+    unsigned long first = 0;
+
+    pthread_mutex_lock(&b->lock);
+    if (b->dead)
+    {
+        pthread_mutex_unlock(&b->lock);
+        return 0;
+    }
+    for (;  *text;  text++)
+    {
+        if (!isalnum((unsigned char)*text))
+            continue;
+        if (!m || m->len == maxLine)
+        {
+            m = calloc(1, sizeof(*m));
+            if (!m)
+                break;
+            pthread_mutex_lock(&id_lock);
+            m->id = next_id++;
+            pthread_mutex_unlock(&id_lock);
+            if (!first)
+                first = m->id;
+            clock_gettime(CLOCK_MONOTONIC, &m->queued);
+            if (b->last)
+                b->last->next = m;
+            else
+                b->head = m;
+            b->last = m;
+            b->queued++;
+        }
+        m->text[m->len++] = *text;
+    }
+    if (first)
+        schedule(b);
+    pthread_mutex_unlock(&b->lock);
+    return first;
+}
+
+/* --------------------------- SOCKET COMMANDS --------------------------- */
+
+static void command(struct client *c, char *line)
+{
+    char *arg;
+    int i;
+
+    arg = strchr(line, ' ');
+    if (arg)
+        *arg++ = 0;
+
+    if (strcmp(line, "LIST") == 0)
+    {
+        for (i = 0;  i < nboards;  i++)
+        {
+            struct board *b = &boards[i];
+
+            pthread_mutex_lock(&b->lock);
+            client_printf(c, "BOARD %d %s %s queued=%d sent=%lu rx=%lu\n", i, b->path,
+                          b->dead ? "dead" : state_name[b->state], b->queued + (b->current != NULL),
+                          b->sent, b->received);
+            pthread_mutex_unlock(&b->lock);
+        }
+        client_printf(c, "OK\n");
+    }
+    else if (strcmp(line, "SEND") == 0 && arg)
+    {
+        char *text;
+        unsigned long id;
+
+        i = strtol(arg, &text, 10);
+        if (text == arg || i < 0 || i >= nboards || boards[i].dead)
+        {
+            client_printf(c, "ERR board\n");
+            return;
+        }
+        id = enqueue(&boards[i], text);
+        if (id)
+            client_printf(c, "OK %lu\n", id);
+        else if (boards[i].dead)
+            client_printf(c, "ERR board\n");
+        else
+            client_printf(c, "ERR empty\n");
+    }
+    else if (strcmp(line, "STATS") == 0)
+    {
+        unsigned long sent = 0, received = 0, progress = 0, rejected = 0;
+        int queued = 0, ready = 0;
+
+        for (i = 0;  i < nboards;  i++)
+        {
+            struct board *b = &boards[i];
+
+            pthread_mutex_lock(&b->lock);
+            sent += b->sent;
+            received += b->received;
+            progress += b->progress;
+            rejected += b->rejected;
+            queued += b->queued + (b->current != NULL);
+            ready += (b->state == BOARD_READY && !b->dead);
+            pthread_mutex_unlock(&b->lock);
+        }
+        client_printf(c, "STATS boards=%d ready=%d queued=%d sent=%lu chars=%lu rx=%lu rejected=%lu\n",
+                      nboards, ready, queued, sent, progress, received, rejected);
+    }
+    else if (strcmp(line, "SUB") == 0)
+    {
+        c->subscribed = TRUE;
+        client_printf(c, "OK\n");
+    }
+    else
+    {
+        client_printf(c, "ERR command\n");
+    }
+}
+
+static void client_accept(void)
+{
+    struct epoll_event ev;
+    struct client *c;
+    int fd;
+
+    while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+    {
+        c = calloc(1, sizeof(*c));
+        if (!c)
+        {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        ev.events = EPOLLIN;
+        ev.data.u64 = TAG_CLIENT | (uintptr_t)c;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        pthread_mutex_lock(&clients_lock);
+        c->next = clients;
+        clients = c;
+        pthread_mutex_unlock(&clients_lock);
+    }
+}
+
+static void client_close(struct client *c)
+{
+    struct client **p;
+
+    pthread_mutex_lock(&clients_lock);
+    for (p = &clients;  *p;  p = &(*p)->next)
+    {
+        if (*p == c)
+        {
+            *p = c->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&clients_lock);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c);
+}
+
+static void client_readable(struct client *c)
+{
+    ssize_t n;
+
+    for (;;)
+    {
+        char *nl;
+
+        n = read(c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len);
+        if (n == 0 || (n < 0 && errno != EAGAIN))
+        {
+            client_close(c);
+            return;
+        }
+        if (n < 0)
+            return;
+        c->len += n;
+        c->line[c->len] = 0;
+        while ((nl = strchr(c->line, '\n')) != NULL)
+        {
+            *nl = 0;
+            if (nl > c->line && nl[-1] == '\r')
+                nl[-1] = 0;
+            command(c, c->line);
+            c->len -= nl + 1 - c->line;
+            memmove(c->line, nl + 1, c->len + 1);
+        }
+        if (c->len == (int)sizeof(c->line) - 1)
+            c->len = 0;                         /* Overlong line: discard */
+    }
+}
+
+/* --------------------------------- MAIN --------------------------------- */
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    quit = TRUE;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: gateway [-s socket] [-w workers] port...\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *sock_path = DEFAULT_SOCKET;
+    int nworkers = DEFAULT_WORKERS;
+    struct epoll_event ev, events[MAX_EVENTS];
+    struct sockaddr_un addr;
+    pthread_t *threads;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "s:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': sock_path = optarg; break;
+        case 'w': nworkers = atoi(optarg); break;
+        default: usage();
+        }
+    }
+    nboards = argc - optind;
+    if (nboards <= 0 || nworkers <= 0)
+        usage();
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    epfd = epoll_create1(0);
+    if (epfd < 0)
+        die("epoll_create1");
+
+    boards = calloc(nboards, sizeof(*boards));
+    jobs = calloc(nboards, sizeof(*jobs));
+    if (!boards || !jobs)
+        die("calloc");
+    for (i = 0;  i < nboards;  i++)
+    {
+        struct board *b = &boards[i];
+
+        b->idx = i;
+        b->path = argv[optind + i];
+        pthread_mutex_init(&b->lock, NULL);
+        b->fd = open_port(b->path);
+        if (b->fd < 0)
+            die(b->path);
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, b->fd, &ev) < 0)
+            die("epoll_ctl");
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0)
+        die("socket");
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+    unlink(sock_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0)
+        die(sock_path);
+    ev.events = EPOLLIN;
+    ev.data.u64 = TAG_LISTEN;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    threads = calloc(nworkers, sizeof(*threads));
+    if (!threads)
+        die("calloc");
+    for (i = 0;  i < nworkers;  i++)
+    {
+        if (pthread_create(&threads[i], NULL, worker, NULL))
+            die("pthread_create");
+    }
+
+    fprintf(stderr, "gateway: %d boards, %d workers, socket %s\n", nboards, nworkers, sock_path);
+
+    while (!quit)
+    {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 500);
+
+        for (i = 0;  i < n;  i++)
+        {
+            uint64_t tag = events[i].data.u64;
+
+            if (tag == TAG_LISTEN)
+                client_accept();
+            else if (tag & TAG_CLIENT)
+            {
+                struct client *c = (struct client *)(uintptr_t)(tag & ~TAG_CLIENT);
+
+                if (events[i].events & EPOLLOUT)
+                    client_writable(c);
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    client_readable(c);         /* May close c */
+            }
+            else
+            {
+                if (events[i].events & EPOLLOUT)
+                    board_writable(&boards[tag]);
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    board_readable(&boards[tag]);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&jobs_lock);
+    pthread_cond_broadcast(&jobs_cond);
+    pthread_mutex_unlock(&jobs_lock);
+    for (i = 0;  i < nworkers;  i++)
+        pthread_join(threads[i], NULL);
+    unlink(sock_path);
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*------------------------------------------------------------------------------
+ * Function:    Morse Code Communication Platform (gateway client)
+ * Description: Command line client for the gateway socket API.
+ *                  gwctl list
+ *                  gwctl stats
+ *                  gwctl send <board> <text>
+ *                  gwctl monitor               print events until ^C
+ *                  gwctl bench <msgs per board> [text]
+ *              "bench" queues the given number of messages on every board at
+ *              once, waits until all of them have been played and reports
+ *              the aggregate rate and the queue-to-done latency.
+ *
+ * Input:       Gateway socket
+ * Output:      stdout
+ * Usage:       gwctl [-s socket] command...
+ *------------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define DEFAULT_SOCKET      "/tmp/morse-gateway.sock"
+
+static FILE *in, *out;
+
+static int connect_gateway(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    in = fdopen(fd, "r");
+    out = fdopen(dup(fd), "w");
+    return fd;
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(int per_board, const char *text)
+{
+    char line[512];
+    long *latency;
+    int nboards = 0, total, done = 0, i, k;
+    double start, secs;
+
+    fprintf(out, "SUB\nLIST\n");
+    fflush(out);
+    while (fgets(line, sizeof(line), in))
+    {
+        if (strncmp(line, "BOARD ", 6) == 0)
+            nboards++;
+        else if (strcmp(line, "OK\n") == 0 && nboards)
+            break;
+    }
+    total = nboards * per_board;
+    if (total == 0)
+        return 1;
+    latency = calloc(total, sizeof(*latency));
+
+    start = now_s();
+    for (k = 0;  k < per_board;  k++)
+    {
+        for (i = 0;  i < nboards;  i++)
+            fprintf(out, "SEND %d %s\n", i, text);
+    }
+    fflush(out);
+
+    while (done < total && fgets(line, sizeof(line), in))
+    {
+        long ms;
+
+        if (sscanf(line, "DONE %*d %*u %ld", &ms) == 1)
+            latency[done++] = ms;
+    }
+    secs = now_s() - start;
+
+    qsort(latency, done, sizeof(*latency), cmp_long);
+    printf("boards %d, messages %d of %d, %.2f s\n", nboards, done, total, secs);
+    printf("throughput %.1f msgs/s, %.1f chars/s\n", done / secs, done * strlen(text) / secs);
+    if (done)
+        printf("latency ms: p50 %ld  p99 %ld  max %ld\n",
+               latency[done / 2], latency[done * 99 / 100], latency[done - 1]);
+    free(latency);
+    return done == total ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *sock_path = DEFAULT_SOCKET;
+    char line[512];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1)
+    {
+        if (opt == 's')
+            sock_path = optarg;
+    }
+    argv += optind;
+    argc -= optind;
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: gwctl [-s socket] list|stats|monitor|send <board> <text>|bench <n> [text]\n");
+        return 2;
+    }
+    connect_gateway(sock_path);
+
+    if (strcmp(argv[0], "bench") == 0 && argc >= 2)
+        return bench(atoi(argv[1]), argc >= 3 ? argv[2] : "cqcqde");
+
+    if (strcmp(argv[0], "list") == 0)
+        fprintf(out, "LIST\n");
+    else if (strcmp(argv[0], "stats") == 0)
+        fprintf(out, "STATS\n");
+    else if (strcmp(argv[0], "monitor") == 0)
+        fprintf(out, "SUB\n");
+    else if (strcmp(argv[0], "send") == 0 && argc >= 3)
+        fprintf(out, "SEND %s %s\n", argv[1], argv[2]);
+    else
+        return 2;
+    fflush(out);
+
+    while (fgets(line, sizeof(line), in))
+    {
+        fputs(line, stdout);
+        fflush(stdout);
+        if (strcmp(argv[0], "monitor") != 0 && strncmp(line, "BOARD ", 6) != 0)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/sh
+#------------------------------------------------------------------------------
+# Function:    Morse Code Communication Platform (memory report)
+# Description: Per-module static RAM/flash use of the firmware, from the
+#              section sizes of the object files (size -A), so string
+#              literals, switch tables, alignment padding and interrupt
+#              vectors are counted along with the named symbols. Run it as a
+#              post-build step on the objects of either firmware:
+#                  host/memreport.sh Debug/4618_code.obj
+#              Code (text) and constants (rodata: .rodata/.const, .cinit,
+#              vectors) live in flash, zero-initialised data (bss) in RAM,
+#              initialised data in both. The stack comes on top of the RAM
+#              total; see the "!m" command / stack_peak for its run time
+#              high-water mark.
+#
+# Input:       Object files (ELF)
+# Output:      Table on stdout
+# Usage:       [SIZE=msp430-elf-size] memreport.sh file.o...
+#------------------------------------------------------------------------------
+SIZE=${SIZE:-msp430-elf-size}
+
+if [ $# -eq 0 ]; then
+    echo "usage: [SIZE=msp430-elf-size] memreport.sh file.o..." >&2
+    exit 2
+fi
+
+printf "%-24s %7s %7s %7s %7s %7s %7s\n" module text rodata data bss flash ram
+for obj in "$@"; do
+    "$SIZE" -A -d "$obj" | awk -v name="$(basename "$obj")" '
+        NR <= 2 || NF != 3 || $1 == "Total" { next }
+        # Not loaded on the target: debug info, notes, build attributes
+        $1 ~ /^\.(debug|comment|note|stab|symtab|strtab|shstrtab|rel|group)/ { next }
+        $1 ~ /^\.(MSP430|mspabi|gnu)/ { next }
+        $1 ~ /^\.(text|init|fini)/ { text += $2; next }
+        $1 ~ /^\.(bss|noinit|tbss)/ || $1 == "COMMON" { bss += $2; next }
+        $1 ~ /^\.(data|tdata)/ { data += $2; next }
+        { rodata += $2 }
+        END {
+            printf "%-24s %7d %7d %7d %7d %7d %7d\n", name, text, rodata, data, bss,
+                   text + rodata + data, data + bss
+        }'
+done | awk '
+    { print; for (i = 2; i <= 7; i++) total[i] += $i }
+    END {
+        if (NR > 1)
+            printf "%-24s %7d %7d %7d %7d %7d %7d\n", "total",
+                   total[2], total[3], total[4], total[5], total[6], total[7]
+    }'
@@ -0,0 +1,194 @@
+/*------------------------------------------------------------------------------
+ * Function:    Morse Code Communication Platform (encode/decode conformance)
+ * Description: Runs the FG4618 encode/decode core (definitions.h, morse.h)
+ *              on the host:
+ *              1. every table symbol: unique Op-Code, element string and
+ *                 MC_code_size agree, decode(encode(c)) == c
+ *              2. random messages: text -> Op-Code (letterToMorse path) ->
+ *                 element timing -> jittered key press lengths in TIMERA
+ *                 ticks -> morseKeyed() -> morseDecode() -> text
+ *              Exits non-zero on any mismatch, so it can gate changes to the
+ *              core, and reports messages/sec for the round trip.
+ *
+ *              Nominal keying is a 2 tick DOT and a 6 tick LINE; -j sets the
+ *              jitter in ticks (default 1, which TA0_ISR must fully absorb).
+ *
+ * Input:       Command line
+ * Output:      stdout
+ * Usage:       morse_bench [-n messages] [-j jitter ticks] [-s seed]
+ *------------------------------------------------------------------------------*/
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../definitions.h"
+#include "../morse.h"
+
+#define FALSE 0
+#define TRUE (!FALSE)
+
+#define maxCharacters   25
+#define DOT_TICKS       2
+#define LINE_TICKS      6
+
+static unsigned long rng_state;
+
+static unsigned long rng(void)
+{
+    /* xorshift, so runs are reproducible across libcs */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static int check_table(void)
+{
+    int errors = 0;
+    int i, j;
+
+    for (i = 0;  i < MC_COUNT;  i++)
+    {
+        uint8_t code = morseEncode(MC_code[i], MC_code_size[i]);
+        char elements[MORSE_ELEMENTS];
+        int size = morseSize(code);
+
+        if (MC_code_size[i] != (char)(strlen(MC_code[i]) + 1) || size > MORSE_ELEMENTS)
+        {
+            printf("FAIL %c: MC_code_size %d for \"%s\"\n", MC_chars[i], MC_code_size[i], MC_code[i]);
+            errors++;
+            continue;
+        }
+        if (morseIndex(MC_chars[i]) != i)
+        {
+            printf("FAIL %c: morseIndex %d\n", MC_chars[i], morseIndex(MC_chars[i]));
+            errors++;
+        }
+        for (j = 0;  j < size;  j++)
+            elements[j] = morseElement(code, j);
+        if (memcmp(elements, MC_code[i], size) != 0 || morseDecode(elements, size) != i)
+        {
+            printf("FAIL %c: Op-Code 0x%02x does not round trip \"%s\"\n", MC_chars[i], code, MC_code[i]);
+            errors++;
+        }
+        for (j = 0;  j < i;  j++)
+        {
+            if (morseEncode(MC_code[j], MC_code_size[j]) == code)
+            {
+                printf("FAIL %c and %c share Op-Code 0x%02x\n", MC_chars[i], MC_chars[j], code);
+                errors++;
+            }
+        }
+    }
+    if (morseIndex(' ') != -1 || morseIndex('*') != -1 || morseDecode("______", 6) != -1)
+    {
+        printf("FAIL: characters outside the table are accepted\n");
+        errors++;
+    }
+    return errors;
+}
+
+static int key_ticks(char element, int jitter)
+{
+    int ticks = (element == LINE) ? LINE_TICKS : DOT_TICKS;
+
+    if (jitter)
+        ticks += (int)(rng() % (2*jitter + 1)) - jitter;
+    return ticks;
+}
+
+static int round_trip(const char *text, int len, int jitter, char *decoded)
+{
+    int k, i;
+
+    for (k = 0;  k < len;  k++)
+    {
+        /* letterToMorse */
+        int idx = morseIndex(text[k]);
+        uint8_t code;
+        char touchMsg[MORSE_ELEMENTS];
+        int pos = 0;
+
+        if (idx < 0)
+            return FALSE;
+        code = morseEncode(MC_code[idx], MC_code_size[idx]);
+
+        /* Operator keys each element, TA0_ISR classifies the press length */
+        for (i = 0;  i < morseSize(code);  i++)
+        {
+            char element = morseKeyed(key_ticks(morseElement(code, i), jitter));
+
+            if (element == 0)
+                continue;                       /* Too short to register */
+            touchMsg[pos++] = element;
+        }
+
+        /* morseToLetter */
+        idx = morseDecode(touchMsg, pos);
+        decoded[k] = (idx >= 0) ? MC_chars[idx] : '*';
+    }
+    decoded[len] = 0;
+    for (k = 0;  k < len;  k++)
+    {
+        if (tolower((unsigned char)text[k]) != decoded[k])
+            return FALSE;                       /* Decoder reports lower case */
+    }
+    return TRUE;
+}
+
+int main(int argc, char **argv)
+{
+    long messages = 1000000, failures = 0, chars = 0, n;
+    int jitter = 1;
+    int opt, errors;
+    clock_t start;
+    double secs;
+
+    rng_state = 2463534242UL;
+    while ((opt = getopt(argc, argv, "n:j:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': messages = atol(optarg); break;
+        case 'j': jitter = atoi(optarg); break;
+        case 's': rng_state = strtoul(optarg, NULL, 0) | 1; break;
+        default:
+            fprintf(stderr, "usage: morse_bench [-n messages] [-j jitter ticks] [-s seed]\n");
+            return 2;
+        }
+    }
+
+    errors = check_table();
+    printf("table: %d symbols, %d errors\n", MC_COUNT, errors);
+
+    start = clock();
+    for (n = 0;  n < messages;  n++)
+    {
+        char text[maxCharacters], decoded[maxCharacters];
+        int len = 1 + rng() % (maxCharacters - 1);
+        int k;
+
+        for (k = 0;  k < len;  k++)
+        {
+            char c = MC_chars[rng() % MC_COUNT];
+            text[k] = (rng() & 1) ? c : (char)(c >= 'a' ? c - 'a' + 'A' : c);
+        }
+        chars += len;
+        if (!round_trip(text, len, jitter, decoded))
+        {
+            if (failures < 5)
+                printf("FAIL message %ld: \"%.*s\" -> \"%s\"\n", n, len, text, decoded);
+            failures++;
+        }
+    }
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("round trip: %ld messages, %ld chars, jitter %d ticks, %ld failures\n",
+           messages, chars, jitter, failures);
+    if (secs > 0)
+        printf("throughput: %.0f messages/sec, %.0f chars/sec\n", messages / secs, chars / secs);
+    return (errors || failures) ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/*------------------------------------------------------------------------------
+ * Function:    Morse Code Communication Platform (encode/decode core)
+ * Description: The table work behind letterToMorse(), morseToLetter() and
+ *              the touch pad timing of TA0_ISR, without any hardware access,
+ *              so host/morse_bench.c runs exactly the code the FG4618 runs.
+ *              Needs definitions.h.
+ *
+ *              morseCode Op-Code
+ *              BYTE [XXX43210]
+ *              XXX is LENGTH of letter in . & _
+ *              43210 is msg, order of execution from BIT4 to BIT4 + LENGTH-1
+ *              BIT at 0 if DOT
+ *              BIT at 1 if LINE
+ * Author:		David Tougaw
+ *------------------------------------------------------------------------------*/
+#ifndef MORSE_H
+#define MORSE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define MORSE_FIRST         0x10        // BIT4: first element
+#define MORSE_SIZE_SHIFT    5           // LENGTH in the 3 MSBs
+#define MORSE_ELEMENTS      5           // Longest code in the table
+
+// Touch pad element timing, in TIMERA ticks of 0.1 sec
+#define MORSE_DOT_MAX       4           // 0.1-0.4 sec held: DOT
+                                        // 0.5 sec and up: LINE
+
+// Op-Code for a MC_code[] entry. size includes the NULL END char.
+static uint8_t morseEncode(const char * c, char size)
+{
+    uint8_t code = 0;
+    int k;
+    for(k=0; k < size-1; k++)
+    {
+        if(c[k] == LINE)
+            code |= (MORSE_FIRST >> k);     // set bit if LINE, Shift right by K
+    }
+    return code | ((size-1) << MORSE_SIZE_SHIFT);
+}
+
+// Number of elements in an Op-Code
+static char morseSize(uint8_t code)
+{
+    return code >> MORSE_SIZE_SHIFT;
+}
+
+// Element i of an Op-Code, DOT or LINE
+static char morseElement(uint8_t code, char i)
+{
+    return (code & (MORSE_FIRST >> i)) ? LINE : DOT;
+}
+
+// Table index of a character, -1 if it has no Morse Code
+static int morseIndex(char c)
+{
+    int i;
+    if(c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+    for(i=0; i < MC_COUNT; i++)
+    {
+        if(c == MC_chars[i])
+            return i;
+    }
+    return -1;
+}
+
+// Table index of count received elements, -1 if not in the table
+static int morseDecode(const char * elements, char count)
+{
+    int i;
+    for(i=0; i < MC_COUNT; i++)
+    {
+        // Check Size of MorseCode first to narrow down characters
+        if(MC_code_size[i] == count+1 && memcmp(MC_code[i], elements, count) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Element keyed by holding the pad for ticks TIMERA ticks, 0 if none
+static char morseKeyed(int ticks)
+{
+    if(ticks <= 0)
+        return 0;
+    return (ticks <= MORSE_DOT_MAX) ? DOT : LINE;
+}
+
+#endif
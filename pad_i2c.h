@@ -0,0 +1,41 @@
+/*------------------------------------------------------------------------------
+ * Function:    Morse Code Communication Platform (touch pad I2C link)
+ * Description: I2C protocol between the MSP430F2013 (USI, master) and the
+ *              MSP430FG4618 (USCI, slave at PAD_I2C_ADDR). Included by both
+ *              2013_code.c and 4618_code.c.
+ *
+ *              F2013 -> FG4618 (master write)
+ *                  [pad]                   pad level 0-255, as before
+ *                  [pad][id][lo][hi]       every PAD_POLL_SCANS scans: pad
+ *                                          level plus one status item, the
+ *                                          items taken in turn
+ *              FG4618 -> F2013 (master read, every PAD_POLL_SCANS scans)
+ *                  [reg][value]            configuration write, PAD_REG_NOP
+ *                                          when the FG4618 has nothing queued
+ * Author:		David Tougaw
+ *------------------------------------------------------------------------------*/
+#ifndef PAD_I2C_H
+#define PAD_I2C_H
+
+#define PAD_I2C_ADDR        0x48
+#define PAD_POLL_SCANS      16          // Scans between configuration reads
+
+// Configuration registers (FG4618 -> F2013)
+#define PAD_REG_NOP         0
+#define PAD_REG_FILTER      1           // IIR filter shift, 1-6
+#define PAD_REG_SCAN_DELAY  2           // Wait between scans, x16 loops
+#define PAD_REG_CLAMP       3           // Pad level reported as 255 from here (sensitivity)
+#define PAD_REG_FLOOR       4           // Pad level reported as 0 up to here
+#define PAD_REG_RECAL       5           // Take the current reading as the new baseline
+
+// Status items (F2013 -> FG4618)
+#define PAD_STAT_BASELINE   1           // Untouched pad reading
+#define PAD_STAT_NOISE      2           // Average deviation from the filter output
+#define PAD_STAT_SCAN_RATE  3           // Scans per second
+#define PAD_STAT_NACKS      4           // I2C NACKs since reset
+#define PAD_STAT_STACK      5           // Stack high-water mark, bytes
+#define PAD_STAT_CONFIG     6           // filter shift | scan delay << 8
+#define PAD_STAT_LEVELS     7           // floor | clamp << 8
+#define PAD_STAT_COUNT      7
+
+#endif